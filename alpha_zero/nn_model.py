@@ -57,7 +57,8 @@ class AlphaZeroModel(torch.nn.Module):
         return self.value_head(x), self.policy_head(x)
     
     def export_onnx(self):
-        input_tensor = torch.rand((1, 3, 8, 8), dtype=torch.float32)
+        # batch of 2, a batch of 1 would get specialized by the exporter
+        input_tensor = torch.rand((2, 3, 8, 8), dtype=torch.float32)
 
         return torch.onnx.export(
             self,
@@ -65,11 +66,11 @@ class AlphaZeroModel(torch.nn.Module):
             input_names=["input"],
             output_names=["value", "policy"],
             dynamo=True,
-            # dynamic_axes={
-            #     'input' : {0 : 'batch_size'},
-            #     'value' : {0 : 'batch_size'},
-            #     'policy': {0 : 'batch_size'},
-            # },
+            dynamic_axes={
+                'input' : {0 : 'batch_size'},
+                'value' : {0 : 'batch_size'},
+                'policy': {0 : 'batch_size'},
+            },
         )
 
 
@@ -0,0 +1,63 @@
+import argparse
+import os
+
+import numpy as np
+from onnxruntime.quantization import CalibrationDataReader, QuantFormat, QuantType, quantize_static
+from onnxruntime.quantization.shape_inference import quant_pre_process
+
+from replay_buffer import ReplayBuffer
+
+
+class SelfPlayPositions(CalibrationDataReader):
+    """Boards sampled from the newest self-play generations, fed to the
+    calibration in batches."""
+
+    def __init__(self, datasets_path: str, window: int, samples: int, batch_size: int, seed: int = 0):
+        buffer = ReplayBuffer(datasets_path, window)
+
+        if len(buffer) == 0:
+            raise ValueError(f'no self-play positions in {datasets_path} to calibrate on')
+
+        rng = np.random.default_rng(seed)
+        indices = rng.choice(len(buffer), size=min(samples, len(buffer)), replace=False)
+        boards = np.stack([buffer[index][0].numpy() for index in indices])
+
+        self.batches = iter(np.array_split(boards, max(len(boards) // batch_size, 1)))
+
+    def get_next(self):
+        batch = next(self.batches, None)
+        return None if batch is None else {'input': batch}
+
+
+def quantize(model_path: str, output_path: str, datasets_path: str, window: int, samples: int, batch_size: int):
+    # shape inference and graph cleanup make more nodes quantizable
+    preprocessed_path = output_path + '.pre.onnx'
+    quant_pre_process(model_path, preprocessed_path)
+
+    try:
+        # QDQ with unsigned activations and per channel signed weights maps
+        # to the int8 convolution kernels of the CPU execution provider
+        quantize_static(
+            preprocessed_path,
+            output_path,
+            SelfPlayPositions(datasets_path, window, samples, batch_size),
+            quant_format=QuantFormat.QDQ,
+            activation_type=QuantType.QUInt8,
+            weight_type=QuantType.QInt8,
+            per_channel=True,
+        )
+    finally:
+        os.remove(preprocessed_path)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Post-training INT8 quantization of an exported model.')
+    parser.add_argument('--model', default='models/trained.onnx')
+    parser.add_argument('--output', default='models/trained.int8.onnx')
+    parser.add_argument('--datasets', default='datasets')
+    parser.add_argument('--window', type=int, default=1, help='newest generations to sample from')
+    parser.add_argument('--samples', type=int, default=2048, help='calibration positions')
+    parser.add_argument('--batch-size', type=int, default=64)
+    args = parser.parse_args()
+
+    quantize(args.model, args.output, args.datasets, args.window, args.samples, args.batch_size)
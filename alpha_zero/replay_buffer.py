@@ -0,0 +1,134 @@
+import bisect
+import os
+
+import numpy as np
+import torch
+
+
+DENSE_CHUNK_VERSION = 1
+DENSE_HEADER_BYTES = 16
+DENSE_SAMPLE_FLOATS = 3 * 64 + 65 + 1
+
+COMPACT_CHUNK_VERSION = 2
+COMPACT_HEADER_BYTES = 20
+PROBABILITY_SCALE = 65535.0
+
+BITS = np.arange(64, dtype=np.uint64)
+
+
+class DenseChunk:
+    """Memory-mapped float32 records of a version 1 chunk: board tensor,
+    policy over 65 moves and value (see lib/dataset_format.hpp)."""
+
+    def __init__(self, chunk_path: str | os.PathLike, samples: int):
+        header = np.fromfile(chunk_path, dtype=np.uint32, count=4)
+
+        if header[2] != samples:
+            raise ValueError(f'{chunk_path} does not match the index')
+
+        self.records = np.memmap(chunk_path, dtype='<f4', mode='r', offset=DENSE_HEADER_BYTES,
+                                 shape=(samples, DENSE_SAMPLE_FLOATS))
+
+    def sample(self, index: int):
+        record = self.records[index]
+        board = np.array(record[:3 * 64], dtype=np.float32).reshape(3, 8, 8)
+        policy = np.array(record[3 * 64:-1], dtype=np.float32)
+
+        return board, policy, np.float32(record[-1])
+
+
+class CompactChunk:
+    """Memory-mapped columns of a compact chunk (see lib/dataset_format.hpp)."""
+
+    def __init__(self, chunk_path: str | os.PathLike, samples: int):
+        header = np.fromfile(chunk_path, dtype=np.uint32, count=5)
+        policy_entries = int(header[4])
+
+        if header[2] != samples:
+            raise ValueError(f'{chunk_path} does not match the index')
+
+        def column(dtype, count, offset):
+            return np.memmap(chunk_path, dtype=dtype, mode='r', offset=offset, shape=(count,))
+
+        offset = COMPACT_HEADER_BYTES
+        self.white = column('<u8', samples, offset)
+        self.black = column('<u8', samples, offset + 8 * samples)
+        self.side = column(np.uint8, samples, offset + 16 * samples)
+        self.value = column(np.int8, samples, offset + 17 * samples)
+        policy_counts = column(np.uint8, samples, offset + 18 * samples)
+        self.squares = column(np.uint8, policy_entries, offset + 19 * samples)
+        self.probabilities = column('<u2', policy_entries, offset + 19 * samples + policy_entries)
+
+        self.policy_offsets = np.zeros(samples + 1, dtype=np.int64)
+        np.cumsum(policy_counts, out=self.policy_offsets[1:])
+
+    def sample(self, index: int):
+        board = np.empty((3, 64), dtype=np.float32)
+        board[0] = (self.white[index] >> BITS) & 1
+        board[1] = (self.black[index] >> BITS) & 1
+        board[2] = self.side[index] == 2
+
+        policy = np.zeros(65, dtype=np.float32)
+        begin, end = self.policy_offsets[index], self.policy_offsets[index + 1]
+        policy[self.squares[begin:end]] = self.probabilities[begin:end] / PROBABILITY_SCALE
+
+        return board.reshape(3, 8, 8), policy, np.float32(self.value[index])
+
+
+def read_index(generation_path: str | os.PathLike) -> list[tuple[str, int, int]]:
+    """(chunk path, version, samples) of the complete chunks of one generation."""
+    index_path = os.path.join(generation_path, 'index.txt')
+
+    if not os.path.exists(index_path):
+        return []
+
+    chunks = []
+
+    with open(index_path) as index_file:
+        for line in index_file:
+            name, version, samples, _games = line.split()
+            chunks.append((os.path.join(generation_path, name), int(version), int(samples)))
+
+    return chunks
+
+
+def list_generations(root: str | os.PathLike) -> list[str]:
+    """Generation directories under root, oldest first."""
+    if not os.path.isdir(root):
+        return []
+
+    names = sorted(name for name in os.listdir(root) if name.startswith('gen_'))
+    return [os.path.join(root, name) for name in names]
+
+
+class ReplayBuffer(torch.utils.data.Dataset):
+    """Samples of the newest `window` generations under root. Chunks are
+    memory-mapped and expanded one sample at a time, so shuffled reads keep
+    a constant memory footprint however large the window is."""
+
+    def __init__(self, root: str | os.PathLike, window: int):
+        self.chunks = []
+        self.ends = []
+        total = 0
+
+        for generation_path in list_generations(root)[-window:]:
+            for chunk_path, version, samples in read_index(generation_path):
+                if version == COMPACT_CHUNK_VERSION:
+                    self.chunks.append(CompactChunk(chunk_path, samples))
+                elif version == DENSE_CHUNK_VERSION:
+                    self.chunks.append(DenseChunk(chunk_path, samples))
+                else:
+                    raise ValueError(f'{chunk_path} has unknown dataset version {version}')
+
+                total += samples
+                self.ends.append(total)
+
+    def __len__(self):
+        return self.ends[-1] if self.ends else 0
+
+    def __getitem__(self, index):
+        chunk_id = bisect.bisect_right(self.ends, index)
+        begin = self.ends[chunk_id - 1] if chunk_id else 0
+        board, policy, value = self.chunks[chunk_id].sample(index - begin)
+
+        return torch.from_numpy(board), torch.from_numpy(policy), torch.tensor([value])
@@ -1,22 +1,9 @@
 import os
 import torch
-import numpy as np
 import pytorch_lightning as pl
 
 from nn_model import AlphaZeroModel
-
-
-def load_dataset(dataset_path: str | os.PathLike) -> torch.utils.data.Dataset:
-    with open(os.path.join(dataset_path, 'board.bin'), 'rb') as data_file:
-        x = torch.from_numpy(np.fromfile(data_file, dtype=np.float32)).view(-1, 3, 8, 8)
-    
-    with open(os.path.join(dataset_path, 'policy.bin'), 'rb') as data_file:
-        policy = torch.from_numpy(np.fromfile(data_file, dtype=np.float32)).view(-1, 65)
-
-    with open(os.path.join(dataset_path, 'value.bin'), 'rb') as data_file:
-        value = torch.from_numpy(np.fromfile(data_file, dtype=np.float32)).view(-1, 1)
-
-    return torch.utils.data.TensorDataset(x, policy, value)
+from replay_buffer import ReplayBuffer
 
 
 class LitAlphaZero(pl.LightningModule):
@@ -47,8 +34,9 @@ class LitAlphaZero(pl.LightningModule):
 
 if __name__ == "__main__":
     batch_size = 64
+    replay_window = 5  # newest self-play generations used for training
 
-    dataset = load_dataset("datasets/iter_0")
+    dataset = ReplayBuffer("datasets", replay_window)
 
     dataloader = torch.utils.data.DataLoader(
         dataset,
@@ -0,0 +1,48 @@
+#include "othello.hpp"
+#include "agents/alpha_zero_agent.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// Plays the opening moves of a game with every batch size and reports the
+// search speed of AlphaZeroAgent. The model has to be exported with a dynamic
+// batch axis (see alpha_zero/nn_model.py).
+int main(int argc, char** argv) {
+    std::string model_path = argc > 1 ? argv[1] : "models/trained.onnx";
+    int iters_per_move = argc > 2 ? std::stoi(argv[2]) : 800;
+    int moves = argc > 3 ? std::stoi(argv[3]) : 8;
+
+    std::vector <int> batch_sizes = {1, 2, 4, 8, 16, 32, 64};
+
+    for (int batch_size : batch_sizes) {
+        AlphaZeroAgent agent(model_path, 0.3f, iters_per_move, 1234);
+        agent.set_batch_size(batch_size);
+
+        GameState state;
+        int simulations = 0;
+        int inference_calls = 0;
+        float seconds = 0.0f;
+
+        for (int i = 0; i < moves and not state.is_terminal(); ++i) {
+            auto [move, policy] = agent.select_move(state);
+            auto& stats = agent.get_search_stats();
+
+            simulations += stats.simulations;
+            inference_calls += stats.inference_calls;
+            seconds += stats.seconds;
+
+            state.make_move(move);
+            agent.make_move(move);
+        }
+
+        std::cout << "batch_size " << batch_size
+                  << " simulations " << simulations
+                  << " inference_calls " << inference_calls
+                  << " simulations_per_second " << simulations / seconds
+                  << std::endl;
+    }
+
+    return 0;
+}
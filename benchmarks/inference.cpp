@@ -0,0 +1,137 @@
+#include "othello.hpp"
+#include "onnx_model.hpp"
+#include "positions.hpp"
+#include "random_onnx_model.hpp"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+size_t resident_bytes() {
+    size_t pages_total = 0, pages_resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages_total >> pages_resident;
+
+    return pages_resident * sysconf(_SC_PAGESIZE);
+}
+
+
+// runs one session with batches of boards from positions until seconds
+// have passed, appends the latency of every run
+void run_session(OnnxModel& model, std::vector <GameState> positions, int batch_size, float seconds, std::vector <float>& latencies) {
+    auto batch = model.make_bound_batch(batch_size);
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<float>(seconds);
+
+    for (int run = -1; std::chrono::steady_clock::now() < end; ++run) {
+        for (int i = 0; i < batch_size; ++i) {
+            positions[(run * batch_size + i + positions.size()) % positions.size()].write_tensor_representation(batch->input(i));
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        batch->run(batch_size);
+
+        // the first run sets up the binding and warms the session up
+        if (run >= 0) {
+            latencies.push_back(std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+}
+
+
+void measure(const std::string& model_path, std::vector <GameState>& positions, int batch_size, int intra_op_threads, int sessions, float seconds) {
+    size_t rss_before = resident_bytes();
+
+    // every session has its own pool, so threads * sessions cores are busy
+    ModelConfig config;
+    config.global_thread_pool = false;
+    config.intra_op_threads = intra_op_threads;
+
+    std::vector <std::unique_ptr <OnnxModel>> models;
+    for (int i = 0; i < sessions; ++i) {
+        models.push_back(std::make_unique<OnnxModel>(model_path, config));
+    }
+
+    std::vector <std::vector <float>> latencies(sessions);
+    std::vector <std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < sessions; ++i) {
+        threads.emplace_back(run_session, std::ref(*models[i]), positions, batch_size, seconds, std::ref(latencies[i]));
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    float wall_seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    size_t rss_after = resident_bytes();
+
+    std::vector <float> all_latencies;
+    for (auto& session_latencies : latencies) {
+        all_latencies.insert(all_latencies.end(), session_latencies.begin(), session_latencies.end());
+    }
+
+    if (all_latencies.empty()) {
+        return;
+    }
+
+    std::sort(all_latencies.begin(), all_latencies.end());
+
+    std::cout << "batch_size " << batch_size
+              << " intra_op_threads " << intra_op_threads
+              << " sessions " << sessions
+              << " runs " << all_latencies.size()
+              << " p50_ms " << 1000.0f * all_latencies[all_latencies.size() / 2]
+              << " p99_ms " << 1000.0f * all_latencies[all_latencies.size() * 99 / 100]
+              << " positions_per_second " << all_latencies.size() * batch_size / wall_seconds
+              << " rss_mb " << (rss_after - std::min(rss_before, rss_after)) / (1024.0f * 1024.0f)
+              << std::endl;
+}
+
+
+// Latency and throughput of OnnxModel over batch sizes, intra-op thread
+// counts and concurrent sessions, on positions from random games. Without
+// a model path a randomly initialized network of the given size is
+// written to a temporary file, so the benchmark runs offline; the real
+// network has 256 channels and 8 blocks. rss_mb is the memory the sessions
+// of one configuration added.
+int main(int argc, char** argv) {
+    std::string model_path = argc > 1 ? argv[1] : "";
+    float seconds = argc > 2 ? std::stof(argv[2]) : 0.5f;
+    int channels = argc > 3 ? std::stoi(argv[3]) : 64;
+    int blocks = argc > 4 ? std::stoi(argv[4]) : 4;
+
+    if (model_path.empty() or model_path == "random") {
+        model_path = (std::filesystem::temp_directory_path() / "alpha_zero_random_model.onnx").string();
+        RandomOnnxModel(1234).write(model_path, channels, blocks);
+        std::cout << "model " << model_path << " channels " << channels << " blocks " << blocks << std::endl;
+    }
+
+    std::vector <GameState> positions = random_game_positions(4096, 1234);
+    int cores = std::max<int>(std::thread::hardware_concurrency(), 1);
+
+    std::vector <int> thread_counts = {1, 2, 4};
+    if (cores > 4) {
+        thread_counts.push_back(cores);
+    }
+
+    for (int sessions : {1, 2, 4}) {
+        for (int intra_op_threads : thread_counts) {
+            for (int batch_size : {1, 8, 32, 128}) {
+                measure(model_path, positions, batch_size, intra_op_threads, sessions, seconds);
+            }
+        }
+    }
+
+    return 0;
+}
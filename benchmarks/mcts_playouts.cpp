@@ -0,0 +1,67 @@
+#include "othello.hpp"
+#include "agents/mcts_agent.hpp"
+
+#include <iostream>
+#include <string>
+
+
+void report(const std::string& name, MctsAgent& agent, int moves) {
+    GameState state;
+    SearchStats total;
+
+    for (int i = 0; i < moves and not state.is_terminal(); ++i) {
+        auto [move, policy] = agent.select_move(state);
+        total.simulations += agent.get_search_stats().simulations;
+        total.playouts += agent.get_search_stats().playouts;
+        total.seconds += agent.get_search_stats().seconds;
+
+        state.make_move(move);
+        agent.make_move(move);
+    }
+
+    std::cout << name
+              << " simulations_per_second " << total.simulations_per_second()
+              << " playouts_per_second " << total.playouts_per_second()
+              << std::endl;
+}
+
+
+// Playout throughput of the parallel modes of the MCTS agent. Every mode
+// runs iters_per_move simulations per tree.
+int main(int argc, char** argv) {
+    int iters_per_move = argc > 1 ? std::stoi(argv[1]) : 4000;
+    int moves = argc > 2 ? std::stoi(argv[2]) : 4;
+    int threads = argc > 3 ? std::stoi(argv[3]) : 4;
+    int playouts_per_leaf = argc > 4 ? std::stoi(argv[4]) : 8;
+
+    {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        report("sequential", agent, moves);
+    }
+
+    {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        agent.set_num_threads(threads);
+        report("tree_parallel", agent, moves);
+    }
+
+    {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        agent.set_leaf_parallel(playouts_per_leaf);
+        report("leaf_sequential", agent, moves);
+    }
+
+    {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        agent.set_leaf_parallel(playouts_per_leaf, threads);
+        report("leaf_parallel", agent, moves);
+    }
+
+    {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        agent.set_root_parallel(threads);
+        report("root_parallel", agent, moves);
+    }
+
+    return 0;
+}
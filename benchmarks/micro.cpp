@@ -0,0 +1,175 @@
+#include "othello.hpp"
+#include "agents/mcts_agent.hpp"
+#include "agents/alpha_zero_agent.hpp"
+#include "positions.hpp"
+#include "uniform_model.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// leaf positions of the game tree from the initial position, a game over
+// counts as a leaf and a pass as a move
+const std::vector <long long> PERFT_NODES = {
+    1, 4, 12, 56, 244, 1396, 8200, 55092, 390216, 3005288, 24571284, 212258800
+};
+
+
+long long perft(GameState& state, int depth) {
+    if (depth == 0 or state.is_terminal()) {
+        return 1;
+    }
+
+    const MoveList& moves = state.get_move_list();
+
+    if (depth == 1) {
+        return moves.size();
+    }
+
+    long long nodes = 0;
+
+    for (auto& move : moves) {
+        GameState child = state;
+        child.make_move(move);
+        nodes += perft(child, depth - 1);
+    }
+
+    return nodes;
+}
+
+
+float seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// returns false if the node count differs from the known one
+bool bench_perft(int depth) {
+    GameState state;
+
+    auto start = std::chrono::steady_clock::now();
+    long long nodes = perft(state, depth);
+    float seconds = seconds_since(start);
+
+    bool correct = nodes == PERFT_NODES[depth];
+
+    std::cout << "perft depth " << depth
+              << " nodes " << nodes
+              << " expected " << PERFT_NODES[depth]
+              << " correct " << correct
+              << " nodes_per_second " << nodes / seconds
+              << std::endl;
+
+    return correct;
+}
+
+
+// move generation on positions whose move lists are not cached yet, then
+// every legal move applied to them
+void bench_moves(std::vector <GameState>& positions, int rounds) {
+    long long checksum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int round = 0; round < rounds; ++round) {
+        for (auto& position : positions) {
+            GameState state = position;
+            checksum += state.get_move_list().size();
+        }
+    }
+
+    float seconds = seconds_since(start);
+
+    std::cout << "move_generation positions " << rounds * positions.size()
+              << " positions_per_second " << rounds * positions.size() / seconds
+              << " checksum " << checksum
+              << std::endl;
+
+    long long moves = 0;
+    checksum = 0;
+
+    for (auto& position : positions) {
+        position.get_move_list();  // generated outside of the timing
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    for (int round = 0; round < rounds; ++round) {
+        for (auto& position : positions) {
+            for (auto& move : position.get_move_list()) {
+                GameState state = position;
+                state.make_move(move);
+                checksum += state.hash & 0xff;
+                moves++;
+            }
+        }
+    }
+
+    seconds = seconds_since(start);
+
+    std::cout << "make_move moves " << moves
+              << " moves_per_second " << moves / seconds
+              << " checksum " << checksum
+              << std::endl;
+}
+
+
+template <typename Agent>
+void bench_agent(const std::string& name, Agent& agent, int moves) {
+    GameState state;
+    SearchStats total;
+
+    for (int i = 0; i < moves and not state.is_terminal(); ++i) {
+        auto [move, policy] = agent.select_move(state);
+        total.simulations += agent.get_search_stats().simulations;
+        total.playouts += agent.get_search_stats().playouts;
+        total.seconds += agent.get_search_stats().seconds;
+
+        state.make_move(move);
+        agent.make_move(move);
+    }
+
+    std::cout << name
+              << " simulations " << total.simulations
+              << " simulations_per_second " << total.simulations_per_second()
+              << " playouts_per_second " << total.playouts_per_second()
+              << std::endl;
+}
+
+
+// Quick regression suite of the engine: perft node counts from the initial
+// position (checked against the known values, the exit code is 1 on a
+// mismatch), move generation and make_move throughput, and the search
+// speed of both agents, the AlphaZero one with a constant evaluation so the
+// network does not dominate. Every line is "benchmark key value ...".
+int main(int argc, char** argv) {
+    int perft_depth = argc > 1 ? std::stoi(argv[1]) : 9;
+    int iters_per_move = argc > 2 ? std::stoi(argv[2]) : 4000;
+    int moves = argc > 3 ? std::stoi(argv[3]) : 4;
+
+    bool correct = true;
+
+    for (int depth = 1; depth <= std::min<int>(perft_depth, PERFT_NODES.size() - 1); ++depth) {
+        correct = bench_perft(depth) and correct;
+    }
+
+    std::vector <GameState> positions = random_game_positions(10000, 1234);
+    bench_moves(positions, 20);
+
+    {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        bench_agent("mcts", agent, moves);
+    }
+
+    UniformModel model;
+
+    for (int batch_size : {1, 8}) {
+        AlphaZeroAgent agent(model, 0.3f, iters_per_move, 1234);
+        agent.set_batch_size(batch_size);
+        bench_agent("alpha_zero_batch_" + std::to_string(batch_size), agent, moves);
+    }
+
+    return correct ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+#include "othello.hpp"
+#include "onnx_model.hpp"
+#include "positions.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+void write_boards(std::vector <GameState>& positions, float* boards, int begin, int count) {
+    for (int i = 0; i < count; ++i) {
+        positions[(begin + i) % positions.size()].write_tensor_representation(boards + i * 3 * 64);
+    }
+}
+
+
+// latency percentiles and throughput of one model at one batch size
+void measure_speed(const std::string& name, OnnxModel& model, std::vector <GameState>& positions, int batch_size, int runs) {
+    auto batch = model.make_bound_batch(batch_size);
+    std::vector <float> latencies;
+
+    for (int run = -1; run < runs; ++run) {
+        write_boards(positions, batch->input(), run * batch_size, batch_size);
+
+        auto start = std::chrono::steady_clock::now();
+        batch->run(batch_size);
+        float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+        // the first run sets up the binding and warms the session up
+        if (run >= 0) {
+            latencies.push_back(seconds);
+        }
+    }
+
+    float total = 0.0f;
+    for (float seconds : latencies) {
+        total += seconds;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "model " << name
+              << " batch_size " << batch_size
+              << " p50_ms " << 1000.0f * latencies[latencies.size() / 2]
+              << " p99_ms " << 1000.0f * latencies[latencies.size() * 99 / 100]
+              << " positions_per_second " << runs * batch_size / total
+              << std::endl;
+}
+
+
+// how closely the candidate follows the reference: value errors, how often
+// both prefer the same legal move and the total variation distance of the
+// policies over the legal moves
+void measure_agreement(OnnxModel& reference, OnnxModel& candidate, std::vector <GameState>& positions) {
+    const int batch_size = 128;
+    std::vector <float> boards(batch_size * 3 * 64);
+    std::vector <float> values[2], policies[2];
+
+    for (int m = 0; m < 2; ++m) {
+        values[m].resize(batch_size);
+        policies[m].resize(batch_size * 65);
+    }
+
+    double value_error = 0.0, max_value_error = 0.0, variation = 0.0;
+    int same_best_move = 0;
+
+    for (int begin = 0; begin < (int)positions.size(); begin += batch_size) {
+        int count = std::min<int>(batch_size, positions.size() - begin);
+        write_boards(positions, boards.data(), begin, count);
+
+        reference.run_batch_inference(boards.data(), count, values[0].data(), policies[0].data());
+        candidate.run_batch_inference(boards.data(), count, values[1].data(), policies[1].data());
+
+        for (int i = 0; i < count; ++i) {
+            double error = std::fabs(values[0][i] - values[1][i]);
+            value_error += error;
+            max_value_error = std::max(max_value_error, error);
+
+            const MoveList& moves = positions[begin + i].get_move_list();
+            float sums[2] = {0.0f, 0.0f};
+            int best[2] = {-1, -1};
+
+            for (int m = 0; m < 2; ++m) {
+                const float* policy = policies[m].data() + i * 65;
+
+                for (auto& move : moves) {
+                    int id = move_to_id(move);
+                    sums[m] += policy[id];
+
+                    if (best[m] == -1 or policy[id] > policy[best[m]]) {
+                        best[m] = id;
+                    }
+                }
+            }
+
+            double distance = 0.0;
+
+            for (auto& move : moves) {
+                int id = move_to_id(move);
+                distance += std::fabs(policies[0][i * 65 + id] / sums[0] - policies[1][i * 65 + id] / sums[1]);
+            }
+
+            variation += distance / 2.0;
+            same_best_move += (best[0] == best[1]);
+        }
+    }
+
+    std::cout << "agreement positions " << positions.size()
+              << " value_mae " << value_error / positions.size()
+              << " value_max_error " << max_value_error
+              << " policy_top1 " << same_best_move / (double)positions.size()
+              << " policy_total_variation " << variation / positions.size()
+              << std::endl;
+}
+
+
+// Compares a reduced precision model, e.g. the INT8 model written by
+// alpha_zero/quantize.py, with the FP32 one it was made from: latency and
+// throughput of both at several batch sizes, then the agreement of their
+// values and policies on positions from random games.
+int main(int argc, char** argv) {
+    std::string reference_path = argc > 1 ? argv[1] : "models/trained.onnx";
+    std::string candidate_path = argc > 2 ? argv[2] : "models/trained.int8.onnx";
+    int num_positions = argc > 3 ? std::stoi(argv[3]) : 4096;
+    int runs = argc > 4 ? std::stoi(argv[4]) : 200;
+
+    std::vector <GameState> positions = random_game_positions(num_positions, 1234);
+
+    OnnxModel reference(reference_path);
+    OnnxModel candidate(candidate_path);
+
+    for (int batch_size : {1, 8, 32, 128}) {
+        measure_speed("reference", reference, positions, batch_size, runs);
+        measure_speed("candidate", candidate, positions, batch_size, runs);
+    }
+
+    measure_agreement(reference, candidate, positions);
+
+    return 0;
+}
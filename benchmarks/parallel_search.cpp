@@ -0,0 +1,67 @@
+#include "othello.hpp"
+#include "agents/mcts_agent.hpp"
+#include "agents/alpha_zero_agent.hpp"
+#include "onnx_model.hpp"
+#include "uniform_model.hpp"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+template <typename Agent>
+float simulations_per_second(Agent& agent, int moves) {
+    GameState state;
+    int simulations = 0;
+    float seconds = 0.0f;
+
+    for (int i = 0; i < moves and not state.is_terminal(); ++i) {
+        auto [move, policy] = agent.select_move(state);
+        simulations += agent.get_search_stats().simulations;
+        seconds += agent.get_search_stats().seconds;
+
+        state.make_move(move);
+        agent.make_move(move);
+    }
+
+    return simulations / seconds;
+}
+
+
+// Scaling of the tree-parallel search with the number of threads. The
+// AlphaZero agent uses a constant evaluation unless a model path is given.
+int main(int argc, char** argv) {
+    int iters_per_move = argc > 1 ? std::stoi(argv[1]) : 16000;
+    int moves = argc > 2 ? std::stoi(argv[2]) : 4;
+    std::string model_path = argc > 3 ? argv[3] : "";
+
+    std::unique_ptr <ModelBase> model;
+
+    if (model_path.empty()) {
+        model = std::make_unique<UniformModel>();
+    }
+    else {
+        model = std::make_unique<OnnxModel>(model_path);
+    }
+
+    std::vector <int> thread_counts = {1, 2, 4, 8, 16};
+
+    for (int threads : thread_counts) {
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        agent.set_num_threads(threads);
+
+        std::cout << "mcts threads " << threads
+                  << " simulations_per_second " << simulations_per_second(agent, moves) << std::endl;
+    }
+
+    for (int threads : thread_counts) {
+        AlphaZeroAgent agent(*model, 0.3f, iters_per_move, 1234);
+        agent.set_num_threads(threads);
+
+        std::cout << "alpha_zero threads " << threads
+                  << " simulations_per_second " << simulations_per_second(agent, moves) << std::endl;
+    }
+
+    return 0;
+}
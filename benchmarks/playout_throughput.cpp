@@ -0,0 +1,71 @@
+#include "othello.hpp"
+#include "playout.hpp"
+#include "simd_playout.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+
+template <typename Play>
+void report(const std::string& name, int games, Play play) {
+    auto start = std::chrono::steady_clock::now();
+    int sum = play();
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << name
+              << " games_per_second " << games / seconds
+              << " mean_result " << sum / (float)games
+              << std::endl;
+}
+
+
+// Random playouts per second from the initial position: the GameState
+// playout used by the MCTS agent against the playout lanes, stepped by
+// scalar code and by AVX2 when compiled with -mavx2.
+int main(int argc, char** argv) {
+    int games = argc > 1 ? std::stoi(argv[1]) : 200000;
+    GameState state;
+
+    report("game_state", games, [&] {
+        std::mt19937 rng(1234);
+        int sum = 0;
+
+        for (int i = 0; i < games; ++i) {
+            GameState state_copy = state;
+            sum += random_playout(state_copy, 1, rng);
+        }
+
+        return sum;
+    });
+
+    std::vector <int> results(games);
+
+    report("lanes_scalar", games, [&] {
+        PlayoutLanes lanes(1234);
+        lanes.play_scalar(state, 1, games, results.data());
+
+        int sum = 0;
+        for (int result : results) {
+            sum += result;
+        }
+
+        return sum;
+    });
+
+    report("lanes", games, [&] {
+        PlayoutLanes lanes(1234);
+        lanes.play(state, 1, games, results.data());
+
+        int sum = 0;
+        for (int result : results) {
+            sum += result;
+        }
+
+        return sum;
+    });
+
+    return 0;
+}
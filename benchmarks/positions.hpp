@@ -0,0 +1,30 @@
+#ifndef BENCHMARK_POSITIONS
+#define BENCHMARK_POSITIONS
+
+#include "othello.hpp"
+
+#include <random>
+#include <vector>
+
+// count positions met in random games, every non-terminal position of a
+// game in order, as a realistic mix of openings, midgames and endgames
+std::vector <GameState> random_game_positions(int count, uint_fast32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector <GameState> positions;
+    positions.reserve(count);
+
+    while ((int)positions.size() < count) {
+        GameState state;
+
+        while (not state.is_terminal() and (int)positions.size() < count) {
+            positions.push_back(state);
+
+            const MoveList& moves = state.get_move_list();
+            state.make_move(moves[rng() % moves.size()]);
+        }
+    }
+
+    return positions;
+}
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef RANDOM_ONNX_MODEL
+#define RANDOM_ONNX_MODEL
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Writes a randomly initialized network with the layout of
+// alpha_zero/nn_model.py (a residual tower with value and policy heads,
+// batch norms folded into the convolutions) as an ONNX file, so inference
+// can be measured without a trained checkpoint or Python. The protobuf
+// messages are encoded by hand, only the fields the model needs.
+class RandomOnnxModel {
+private:
+    using Bytes = std::string;
+
+    std::mt19937 rng;
+    std::vector <Bytes> nodes;
+    std::vector <Bytes> initializers;
+    int next_name = 0;
+
+    static void varint(Bytes& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back((char)(value | 0x80));
+            value >>= 7;
+        }
+
+        out.push_back((char)value);
+    }
+
+    static void tag(Bytes& out, int field, int wire_type) {
+        varint(out, (uint64_t)field << 3 | wire_type);
+    }
+
+    static void int_field(Bytes& out, int field, int64_t value) {
+        tag(out, field, 0);
+        varint(out, (uint64_t)value);
+    }
+
+    static void bytes_field(Bytes& out, int field, const Bytes& value) {
+        tag(out, field, 2);
+        varint(out, value.size());
+        out += value;
+    }
+
+    static Bytes attribute(const std::string& name, const std::vector <int64_t>& ints) {
+        Bytes out;
+        bytes_field(out, 1, name);
+        for (int64_t value : ints) {
+            int_field(out, 8, value);
+        }
+        int_field(out, 20, 7);  // INTS
+
+        return out;
+    }
+
+    static Bytes attribute(const std::string& name, int64_t value) {
+        Bytes out;
+        bytes_field(out, 1, name);
+        int_field(out, 3, value);
+        int_field(out, 20, 2);  // INT
+
+        return out;
+    }
+
+    // shape with a symbolic batch dimension in front
+    static Bytes value_info(const std::string& name, const std::vector <int64_t>& dims) {
+        Bytes shape;
+        Bytes batch_dim;
+        bytes_field(batch_dim, 2, "batch_size");
+        bytes_field(shape, 1, batch_dim);
+
+        for (int64_t dim : dims) {
+            Bytes dimension;
+            int_field(dimension, 1, dim);
+            bytes_field(shape, 1, dimension);
+        }
+
+        Bytes tensor_type;
+        int_field(tensor_type, 1, 1);  // FLOAT
+        bytes_field(tensor_type, 2, shape);
+
+        Bytes type;
+        bytes_field(type, 1, tensor_type);
+
+        Bytes out;
+        bytes_field(out, 1, name);
+        bytes_field(out, 2, type);
+
+        return out;
+    }
+
+    std::string fresh_name() {
+        return "t" + std::to_string(next_name++);
+    }
+
+    void add_node(const std::string& op_type, const std::vector <std::string>& inputs, const std::string& output, const std::vector <Bytes>& attributes = {}) {
+        Bytes node;
+
+        for (auto& input : inputs) {
+            bytes_field(node, 1, input);
+        }
+
+        bytes_field(node, 2, output);
+        bytes_field(node, 4, op_type);
+
+        for (auto& attr : attributes) {
+            bytes_field(node, 5, attr);
+        }
+
+        nodes.push_back(node);
+    }
+
+    std::string add_initializer(const std::vector <int64_t>& dims, int data_type, const Bytes& raw_data) {
+        std::string name = fresh_name();
+        Bytes tensor;
+
+        for (int64_t dim : dims) {
+            int_field(tensor, 1, dim);
+        }
+
+        int_field(tensor, 2, data_type);
+        bytes_field(tensor, 8, name);
+        bytes_field(tensor, 9, raw_data);
+
+        initializers.push_back(tensor);
+        return name;
+    }
+
+    // He initialization, scaled down so that deep towers stay finite
+    std::string add_weights(const std::vector <int64_t>& dims, int fan_in, float scale = 1.0f) {
+        size_t count = 1;
+        for (int64_t dim : dims) {
+            count *= dim;
+        }
+
+        std::normal_distribution <float> normal(0.0f, scale * std::sqrt(2.0f / fan_in));
+        std::vector <float> values(count);
+
+        for (float& value : values) {
+            value = normal(rng);
+        }
+
+        return add_initializer(dims, 1, Bytes(reinterpret_cast<const char*>(values.data()), count * sizeof(float)));
+    }
+
+    std::string add_bias(int64_t size) {
+        return add_initializer({size}, 1, Bytes(size * sizeof(float), '\0'));
+    }
+
+    std::string conv(const std::string& input, int in_channels, int out_channels, int kernel, float scale = 1.0f) {
+        std::string output = fresh_name();
+        int pad = kernel / 2;
+
+        add_node("Conv", {input, add_weights({out_channels, in_channels, kernel, kernel}, in_channels * kernel * kernel, scale), add_bias(out_channels)}, output, {
+            attribute("kernel_shape", {kernel, kernel}),
+            attribute("pads", {pad, pad, pad, pad}),
+        });
+
+        return output;
+    }
+
+    std::string dense(const std::string& input, int in_features, int out_features, float scale = 1.0f) {
+        std::string output = fresh_name();
+        add_node("Gemm", {input, add_weights({in_features, out_features}, in_features, scale), add_bias(out_features)}, output);
+
+        return output;
+    }
+
+    std::string unary(const std::string& op_type, const std::string& input, const std::string& output = "") {
+        std::string name = output.empty() ? fresh_name() : output;
+        add_node(op_type, {input}, name);
+
+        return name;
+    }
+
+    // 1x1 convolution to one plane flattened to 64 features, then a hidden
+    // layer; small output weights keep the value and policy away from saturation
+    std::string head(const std::string& input, int channels, const std::string& shape, int outputs) {
+        std::string plane = unary("Relu", conv(input, channels, 1, 1));
+        std::string flat = fresh_name();
+        add_node("Reshape", {plane, shape}, flat);
+
+        return dense(unary("Relu", dense(flat, 64, 256)), 256, outputs, 0.1f);
+    }
+
+public:
+    RandomOnnxModel(uint_fast32_t seed = 1234) : rng(seed) {}
+
+    void write(const std::string& path, int channels = 64, int blocks = 4) {
+        nodes.clear();
+        initializers.clear();
+
+        std::string x = unary("Relu", conv("input", 3, channels, 3));
+
+        for (int block = 0; block < blocks; ++block) {
+            std::string y = conv(unary("Relu", conv(x, channels, channels, 3)), channels, channels, 3, 0.5f);
+            std::string sum = fresh_name();
+            add_node("Add", {y, x}, sum);
+            x = unary("Relu", sum);
+        }
+
+        int64_t flat_shape[2] = {-1, 64};
+        std::string shape = add_initializer({2}, 7, Bytes(reinterpret_cast<const char*>(flat_shape), sizeof(flat_shape)));
+
+        unary("Tanh", head(x, channels, shape, 1), "value");
+        std::string logits = head(x, channels, shape, 65);
+        add_node("Softmax", {logits}, "policy", {attribute("axis", 1)});
+
+        Bytes graph;
+        for (auto& node : nodes) {
+            bytes_field(graph, 1, node);
+        }
+        bytes_field(graph, 2, "random_alpha_zero");
+        for (auto& tensor : initializers) {
+            bytes_field(graph, 5, tensor);
+        }
+        bytes_field(graph, 11, value_info("input", {3, 8, 8}));
+        bytes_field(graph, 12, value_info("value", {1}));
+        bytes_field(graph, 12, value_info("policy", {65}));
+
+        Bytes opset;
+        bytes_field(opset, 1, "");
+        int_field(opset, 2, 17);
+
+        Bytes model;
+        int_field(model, 1, 8);  // IR version
+        bytes_field(model, 2, "alphazero-othello");
+        bytes_field(model, 7, graph);
+        bytes_field(model, 8, opset);
+
+        std::ofstream file(path, std::ios::binary);
+        file.write(model.data(), model.size());
+
+        if (not file) {
+            throw std::runtime_error("Could not write " + path);
+        }
+    }
+};
+
+#endif
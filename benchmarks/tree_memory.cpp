@@ -0,0 +1,130 @@
+#include "othello.hpp"
+#include "agents/mcts_agent.hpp"
+#include "agents/alpha_zero_agent.hpp"
+#include "positions.hpp"
+#include "uniform_model.hpp"
+
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+size_t resident_bytes() {
+    size_t pages_total = 0, pages_resident = 0;
+    std::ifstream statm("/proc/self/statm");
+    statm >> pages_total >> pages_resident;
+
+    return pages_resident * sysconf(_SC_PAGESIZE);
+}
+
+
+template <typename Agent>
+void measure(const std::string& name, Agent& agent, size_t rss_before, int moves) {
+    GameState state;
+    int nodes = 1;  // root
+    float seconds = 0.0f;
+
+    for (int i = 0; i < moves and not state.is_terminal(); ++i) {
+        auto start = std::chrono::steady_clock::now();
+        auto [move, policy] = agent.select_move(state);
+        seconds += std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+        nodes += agent.get_search_stats().expansions;
+
+        state.make_move(move);
+        agent.make_move(move);
+    }
+
+    size_t bytes = resident_bytes() - rss_before;
+
+    std::cout << name
+              << " nodes " << nodes
+              << " bytes_per_node " << bytes / (float)nodes
+              << " nodes_per_second " << nodes / seconds
+              << std::endl;
+}
+
+
+// Node layouts of both agents before the edge arenas: every node owned a
+// vector of its children, which took a heap block per node.
+struct LegacyMctsNode {
+    std::vector <std::pair <move, int>> children;
+    int visits;
+    int score;
+};
+
+struct LegacyAlphaZeroChild {
+    move mv;
+    int node_id;
+    float policy_score;
+};
+
+struct LegacyAlphaZeroNode {
+    std::vector <LegacyAlphaZeroChild> children;
+    int visits;
+    float score;
+    float evaluation_value;
+    bool pending;
+};
+
+
+// resident memory per node of a tree of nodes nodes in the legacy layout,
+// every node expanded with the moves of a position from random games
+template <typename Node>
+void measure_legacy(const std::string& name, int nodes) {
+    std::vector <GameState> positions = random_game_positions(4096, 1234);
+    size_t rss_before = resident_bytes();
+
+    std::vector <Node> tree;
+    tree.reserve(nodes);
+
+    for (int i = 0; i < nodes; ++i) {
+        tree.emplace_back();
+        tree.back().children.resize(positions[i % positions.size()].get_move_list().size());
+    }
+
+    size_t bytes = resident_bytes() - rss_before;
+
+    std::cout << name
+              << " nodes " << nodes
+              << " bytes_per_node " << bytes / (float)nodes
+              << " node_bytes " << sizeof(Node)
+              << " child_bytes " << sizeof(tree[0].children[0])
+              << std::endl;
+}
+
+
+// Reports the resident memory per tree node and the node creation rate of
+// one agent. Run it once per agent, freed trees would skew the numbers.
+// mcts-legacy and alpha_zero-legacy build a tree of the same size in the
+// node layout before the edge arenas, for comparison.
+int main(int argc, char** argv) {
+    std::string agent_name = argc > 1 ? argv[1] : "mcts";
+    int iters_per_move = argc > 2 ? std::stoi(argv[2]) : 20000;
+    int moves = argc > 3 ? std::stoi(argv[3]) : 10;
+
+    // one node per simulation and the root
+    if (agent_name == "mcts-legacy") {
+        measure_legacy<LegacyMctsNode>(agent_name, iters_per_move * moves + 1);
+    }
+    else if (agent_name == "alpha_zero-legacy") {
+        measure_legacy<LegacyAlphaZeroNode>(agent_name, iters_per_move * moves + 1);
+    }
+    else if (agent_name == "mcts") {
+        size_t rss_before = resident_bytes();
+        MctsAgent agent(1.4f, iters_per_move, 1234);
+        measure(agent_name, agent, rss_before, moves);
+    }
+    else {
+        UniformModel model;
+        size_t rss_before = resident_bytes();
+        AlphaZeroAgent agent(model, 0.3f, iters_per_move, 1234);
+        measure(agent_name, agent, rss_before, moves);
+    }
+
+    return 0;
+}
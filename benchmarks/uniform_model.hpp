@@ -0,0 +1,29 @@
+#ifndef UNIFORM_MODEL
+#define UNIFORM_MODEL
+
+#include "model_base.hpp"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+// constant evaluation, so that benchmarks measure the search and not the network
+class UniformModel : public ModelBase {
+public:
+    std::pair<float, std::array <float, 65>> run_inference(const float* /* board_tensor */) override {
+        std::pair<float, std::array <float, 65>> result;
+        result.first = 0.0f;
+        result.second.fill(1.0f / 65);
+
+        return result;
+    }
+
+    void run_batch_inference(const float* /* board_tensors */, int batch_size, float* values, float* policies) override {
+        for (int i = 0; i < batch_size; ++i) {
+            values[i] = 0.0f;
+            std::fill(policies + i * 65, policies + (i + 1) * 65, 1.0f / 65);
+        }
+    }
+};
+
+#endif
@@ -4,69 +4,199 @@
 #include "agents/random_agent.hpp"
 #include "agents/mcts_agent.hpp"
 #include "agents/alpha_zero_agent.hpp"
-#include "dataset.hpp"
-
+#include "collect_config.hpp"
+#include "dataset_writer.hpp"
+#include "eval_cache.hpp"
+#include "inference_server.hpp"
+#include "instrumentation.hpp"
+#include "replay_buffer.hpp"
+#include "self_play.hpp"
+#include "tracing.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
 #include <thread>
 #include <mutex>
 #include <random>
+#include <string>
 
 
-Dataset dataset(2000000);
-std::mutex dataset_mutex;
 std::mutex std_out_mutex;
-int game_id = 1;
+int games_done = 0;
+
 
+void collect_data_from_games(InferenceServer& server, DatasetWriter& dataset, const SelfPlayConfig& config, GameSchedule& schedule, int num_games) {
+    run_self_play_worker(server, config, schedule, [&dataset, num_games](int game_id, GameHistory& game_history) {
+        dataset.add_game(game_history, game_id);
 
-void collect_data_from_games(int num_games, uint_fast32_t seed) {
-    std::mt19937 random_gen(seed);
+        {
+            PROFILE_SCOPE(output_lock);
+            std_out_mutex.lock();
+        }
 
-    for (int r = 0; r < num_games; ++r) {
-        std_out_mutex.lock();
-        std::cout << "Starting game " << game_id << std::endl;
-        game_id++;
+        games_done++;
+        std::cout << "Finished game " << game_id << " (" << games_done << "/" << num_games << ")" << std::endl;
         std_out_mutex.unlock();
+    });
+}
+
 
-        auto agent1 = std::make_unique<AlphaZeroAgent>("models/trained.onnx", 0.3f, 800, random_gen());
-        auto agent2 = std::make_unique<AlphaZeroAgent>("models/trained.onnx", 0.3f, 800, random_gen());
+void print_usage() {
+    std::cout << "usage: collect_dataset [--config FILE] [--resume] [--KEY VALUE]...\n"
+              << "  --config FILE  \"KEY VALUE\" lines, command line options take precedence\n"
+              << "  --resume       continue the newest generation if its games are not all\n"
+              << "                 on disk, with the settings it was started with\n"
+              << "options and their defaults:\n";
 
-        bool swap_agents = random_gen() % 2;
+    CollectConfig().write(std::cout);
+}
 
-        GameHistory game_history;
 
-        if (not swap_agents) {
-            game_history = play_game(std::move(agent1), std::move(agent2));
+int main(int argc, char** argv) {
+    CollectConfig run;
+    bool resume = false;
+    std::vector <std::pair <std::string, std::string>> options;
+    std::vector <std::pair <std::string, std::string>> overrides;
+
+    try {
+        for (auto& [key, value] : parse_command_line(argc, argv, {"resume", "help"})) {
+            if (key == "help") {
+                print_usage();
+                return 0;
+            }
+            else if (key == "resume") {
+                resume = true;
+            }
+            else {
+                options.emplace_back(key, value);
+
+                if (key != "config") {
+                    overrides.emplace_back(key, value);
+                }
+            }
         }
-        else {
-            game_history = play_game(std::move(agent2), std::move(agent1));
+
+        run.apply(options);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        print_usage();
+        return 1;
+    }
+
+    // a generation is resumed with its saved settings, except those given on the command line
+    std::string output_directory;
+    std::vector <int> games_on_disk;
+
+    std::vector <int> generations = list_generations(run.datasets_path);
+
+    if (resume and not generations.empty()) {
+        std::string newest = generation_directory(run.datasets_path, generations.back());
+        std::string saved_path = newest + "/run.cfg";
+
+        if (std::filesystem::exists(saved_path)) {
+            CollectConfig saved;
+            saved.load(saved_path);
+
+            for (auto& [key, value] : overrides) {
+                saved.set(key, value);
+            }
+
+            std::vector <int> recovered = DatasetWriter::recover(newest);
+
+            if ((int)recovered.size() < saved.games) {
+                run = saved;
+                output_directory = newest;
+                games_on_disk = recovered;
+            }
         }
+    }
 
-        dataset_mutex.lock();
-        for (auto& history_sample : game_history.history) {
-            dataset.add(history_sample.board, history_sample.policy, history_sample.value);
+    // games are streamed into a new generation of the replay buffer as they finish
+    if (output_directory.empty()) {
+        if (not run.seed) {
+            run.seed = std::random_device()() | 1;
         }
-        dataset_mutex.unlock();
+
+        prune_generations(run.datasets_path, run.generations_kept - 1);
+        output_directory = new_generation_directory(run.datasets_path);
+        std::filesystem::create_directories(output_directory);
+
+        std::string saved_path = output_directory + "/run.cfg";
+        std::ofstream saved(saved_path + ".tmp");
+        run.write(saved);
+        saved.close();
+        std::filesystem::rename(saved_path + ".tmp", saved_path);
     }
-}
 
+    // games whose chunks are on disk are not played again
+    std::vector <int> game_ids;
 
-int main() {
-    int num_threads = 20;
-    int repeats_per_thread = 10;
-    std::srand(std::time(NULL));
+    for (int game_id = 0; game_id < run.games; ++game_id) {
+        if (not std::binary_search(games_on_disk.begin(), games_on_disk.end(), game_id)) {
+            game_ids.push_back(game_id);
+        }
+    }
+
+    games_done = run.games - game_ids.size();
+    std::cout << "Generation " << output_directory << ": " << games_done << " of " << run.games
+              << " games on disk, seed " << run.seed << std::endl;
+
+    GameSchedule schedule(game_ids, run.seed);
+    SelfPlayConfig config = run.self_play_config();
+
+    // one session for all games, batches are formed across threads
+    InferenceServer server(run.model_path, run.max_batch, std::chrono::microseconds(run.max_wait_us));
+
+    // positions repeat within and across games, their evaluations are reused
+    if (run.cache_mb) {
+        config.eval_cache = shared_eval_cache(run.model_path, (size_t)run.cache_mb << 20);
+    }
+
+    DatasetWriter dataset(output_directory, run.chunk_samples);
+    dataset.set_augment_symmetries(run.augment_symmetries);
+
+    // timeline of the last events of every thread, written to trace.json
+    if (run.trace_events) {
+        start_tracing(run.trace_events);
+    }
 
-    std::vector <std::thread> threads(num_threads);
+    // per phase timings, in builds with -DENABLE_INSTRUMENTATION
+    MetricsReporter metrics(std::cout, std::chrono::seconds(run.metrics_interval), &std_out_mutex);
 
-    for (int i = 0; i < num_threads; ++i) {
-        threads[i] = std::thread(collect_data_from_games, repeats_per_thread, std::rand());
+    // each thread multiplexes many games, so a few threads keep the batches full
+    std::vector <std::thread> threads(run.threads);
+
+    for (auto& thread : threads) {
+        thread = std::thread(collect_data_from_games, std::ref(server), std::ref(dataset), std::cref(config), std::ref(schedule), run.games);
     }
 
     for (auto& thread : threads) {
         thread.join();
     }
 
-    dataset.dump("datasets/iter_0/");
+    std::cout << "Inference batches: " << server.get_total_batches()
+              << ", average batch size: " << server.batch_occupancy() << std::endl;
+
+    if (config.eval_cache) {
+        std::cout << "Evaluation cache hit rate: " << config.eval_cache->hit_rate()
+                  << ", evictions: " << config.eval_cache->get_evictions() << std::endl;
+    }
+
+    dataset.flush();
+
+    if (run.trace_events) {
+        std::ofstream trace_file(output_directory + "/trace.json");
+        write_chrome_trace(trace_file);
+    }
+
+    if (INSTRUMENTATION_COMPILED) {
+        std::ofstream metrics_file(output_directory + "/metrics.json");
+        metrics.write_json(metrics_file);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
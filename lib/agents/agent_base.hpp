@@ -4,10 +4,32 @@
 #include "othello.hpp"
 #include "utils.hpp"
 
+// counters collected by the tree search agents during one select_move call
+struct SearchStats {
+    int simulations = 0;
+    int expansions = 0;
+    int expansions_saved = 0;  // new positions found in the transposition table
+    int inferences = 0;
+    int inferences_saved = 0;
+    int inference_calls = 0;  // one call can evaluate a whole batch
+    int playouts = 0;         // random games played to the end
+    int solved = 0;           // positions solved by the endgame solver
+    float seconds = 0.0f;
+
+    float simulations_per_second() const {
+        return seconds > 0.0f ? simulations / seconds : 0.0f;
+    }
+
+    float playouts_per_second() const {
+        return seconds > 0.0f ? playouts / seconds : 0.0f;
+    }
+};
+
 class AgentBase {
 public:
     virtual std::pair<move, std::vector <std::pair <move, int>>> select_move(GameState& state) = 0;
     virtual void make_move(const move& move) = 0;
+    virtual ~AgentBase() = default;
 };
 
 #endif
@@ -2,74 +2,104 @@
 #define ALPHA_ZERO_AGENT
 
 #include "agents/agent_base.hpp"
+#include "agents/tree_compaction.hpp"
+#include "atomic_utils.hpp"
+#include "endgame_solver.hpp"
+#include "eval_cache.hpp"
+#include "instrumentation.hpp"
+#include "model_base.hpp"
 #include "onnx_model.hpp"
 #include "othello.hpp"
+#include "symmetry.hpp"
+#include "tracing.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <random>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 #include <onnxruntime/onnxruntime_cxx_api.h>
 
 class AlphaZeroAgent : public AgentBase {
 private:
-    const int DEFAULT_SIZE = 2000000;
     const int BEST_MOVE_THRESH = 10;
-    struct Child {
-        move mv;
-        int node_id;
-        float policy_score;
 
-        Child(move mv, int node_id, float policy_score)
-            : mv(mv), node_id(node_id), policy_score(policy_score) {}
+    // children of every node are stored contiguously in one edge arena
+    struct Edge {
+        int node_id;         // -1 until the child is expanded
+        float policy_score;
+        uint8_t square;      // move_to_id of the move
     };
 
     struct MctsTreeNode {
-        std::vector <Child> children;
         int visits;
         float score;
         float evaluation_value;
+        uint32_t first_edge;
+        uint8_t num_edges;
+        bool pending;  // waiting for a batched evaluation
+        uint8_t symmetry;  // maps the position to its canonical form, 0 without canonical keys
+        int8_t solved;  // proven result for the player that moved here, or UNSOLVED
+    };
 
-        MctsTreeNode(GameState& state, OnnxModel& model) {
-            visits = 0;
-            score = 0;
-            evaluation_value = 0.0;
+    static constexpr int8_t UNSOLVED = 2;
 
-            auto valid_moves = state.get_valid_moves();
+    // leaf collected during a batched search step
+    struct PendingLeaf {
+        GameState state;
+        int path_begin;
+        int path_end;
+    };
 
-            if (state.is_terminal()) {
-                auto scores = state.get_scores();
+    std::vector <MctsTreeNode> tree;
+    std::vector <Edge> edges;
 
-                if (scores.first < scores.second) {
-                    evaluation_value = (state.current_player == 1 ? -1.0 : 1.0);
-                }
+    // position hash -> node id, turns the tree into a DAG when enabled. With
+    // canonical keys every node is also entered under the hash of its
+    // canonical form, where the first node of the position in any orientation
+    // stays; a symmetric variant has its moves on other squares, so it only
+    // shares the evaluation of that node and not its subtree
+    bool use_transpositions = false;
+    bool canonical_transpositions = false;
+    std::unordered_map <uint64_t, int> transpositions;
 
-                if (scores.first > scores.second) {
-                    evaluation_value = (state.current_player == 1 ? 1.0 : -1.0);
-                }
-            }
-            else {
-                auto board_tensor = state.get_tensor_representation();
-                auto [value, policy] = model.run_inference(board_tensor);
+    // keeps the canonical keys apart from the position hashes in the table
+    static constexpr uint64_t CANONICAL_KEY = 0x9e3779b97f4a7c15ull;
+    SearchStats stats;
 
-                evaluation_value = value;
+    // tree-parallel search, nodes and edges are taken from preallocated arena slots
+    static constexpr int EXPANDING = -2;  // node_id of an edge claimed by a thread
+    int num_threads = 1;
+    std::atomic <int> next_node{0};
+    std::atomic <uint32_t> next_edge{0};
+    std::atomic <int> simulations_started{0};
 
-                children.reserve(64);
-                float policy_sum = 0.0f;
+    // batched search buffers, reused between steps
+    const float VIRTUAL_LOSS = 1.0f;
+    int batch_size = 1;
+    std::vector <int> batch_paths;
+    std::vector <PendingLeaf> pending_leaves;
+    std::vector <float> batch_tensors;
+    std::vector <float> batch_values;
+    std::vector <float> batch_policies;
+    bool evaluating_root = false;  // the batch holds only the root
+    std::chrono::steady_clock::time_point search_start;
 
-                for (auto& move : valid_moves) {
-                    int id = move_to_id(move);
-                    policy_sum += policy[id];
-                }
+    // positions with at most this many empty squares are solved exactly
+    // instead of evaluated by the model, 0 disables
+    int solver_empties = 0;
 
-                for (auto& move : valid_moves) {
-                    int id = move_to_id(move);
-                    children.emplace_back(move, -1, policy[id] / policy_sum);
-                }
-            }
-        }
-    };
+    // model evaluations shared with other agents, may be null
+    std::shared_ptr <EvalCache> eval_cache;
 
-    std::vector <MctsTreeNode> tree;
     GameState root;
     int root_id = 0;
     float puct_factor;
@@ -77,23 +107,246 @@ private:
     std::mt19937 generator;
     int move_cnt;
 
-    OnnxModel model;
+    std::unique_ptr <ModelBase> owned_model;
+    ModelBase* model;
 
     void root_add_noise() {}
 
+    int position_symmetry(const GameState& state) const {
+        return canonical_transpositions ? canonical_symmetry(state) : 0;
+    }
+
+    void add_transposition(const GameState& state, int node_id) {
+        transpositions.emplace(state.hash, node_id);
+
+        if (canonical_transpositions) {
+            transpositions.emplace(canonical_hash(state, tree[node_id].symmetry) ^ CANONICAL_KEY, node_id);
+        }
+    }
+
+    // node of the same position reached by another move order
+    int find_transposition(const GameState& state) const {
+        if (not use_transpositions) {
+            return -1;
+        }
+
+        auto it = transpositions.find(state.hash);
+        return it == transpositions.end() ? -1 : it->second;
+    }
+
+    // evaluated node of a symmetric variant of the position
+    int find_symmetric_evaluation(const GameState& state) const {
+        if (not use_transpositions or not canonical_transpositions) {
+            return -1;
+        }
+
+        auto it = transpositions.find(canonical_hash(state) ^ CANONICAL_KEY);
+
+        if (it == transpositions.end()) {
+            return -1;
+        }
+
+        const MctsTreeNode& node = tree[it->second];
+        return node.num_edges and not node.pending ? it->second : -1;
+    }
+
+    Edge& child_edge(int node_id, int ch) {
+        return edges[tree[node_id].first_edge + ch];
+    }
+
+    static float evaluate_terminal(GameState& state) {
+        auto scores = state.get_scores();
+
+        if (scores.first < scores.second) {
+            return state.current_player == 1 ? -1.0 : 1.0;
+        }
+
+        if (scores.first > scores.second) {
+            return state.current_player == 1 ? 1.0 : -1.0;
+        }
+
+        return 0.0;
+    }
+
+    // terminal and solved positions are not expanded, their value is exact
+    bool is_exact_leaf(GameState& state) const {
+        return state.is_terminal() or (solver_empties and count_empties(state) <= solver_empties);
+    }
+
+    static float evaluate_exact(GameState& state, SearchStats& search_stats) {
+        if (state.is_terminal()) {
+            return evaluate_terminal(state);
+        }
+
+        search_stats.solved++;
+        return thread_endgame_solver().solve_result(state);
+    }
+
+    static void write_edges(Edge* out, const MoveList& valid_moves, const float* policy) {
+        float policy_sum = 0.0f;
+
+        for (auto& move : valid_moves) {
+            int id = move_to_id(move);
+            policy_sum += policy[id];
+        }
+
+        for (auto& move : valid_moves) {
+            int id = move_to_id(move);
+            *out++ = Edge{-1, policy[id] / policy_sum, (uint8_t)id};
+        }
+    }
+
+    void expand(int node_id, GameState& state, float value, const float* policy) {
+        const MoveList& valid_moves = state.get_move_list();
+
+        tree[node_id].evaluation_value = value;
+        tree[node_id].pending = false;
+        tree[node_id].first_edge = edges.size();
+        tree[node_id].num_edges = valid_moves.size();
+
+        edges.resize(edges.size() + valid_moves.size());
+        write_edges(edges.data() + tree[node_id].first_edge, valid_moves, policy);
+    }
+
+    // adds an unevaluated node, terminal and solved positions are evaluated right away
+    int push_node(GameState& state) {
+        int symmetry = position_symmetry(state);
+        tree.push_back(MctsTreeNode{0, 0.0f, 0.0f, 0, 0, false, (uint8_t)symmetry, UNSOLVED});
+        stats.expansions++;
+
+        if (is_exact_leaf(state)) {
+            tree.back().evaluation_value = evaluate_exact(state, stats);
+            tree.back().solved = (int8_t)-tree.back().evaluation_value;
+        }
+
+        if (use_transpositions) {
+            add_transposition(state, tree.size() - 1);
+        }
+
+        return tree.size() - 1;
+    }
+
+    // expands node_id with the evaluation of source_id, a symmetric variant
+    // of its position, with the priors moved to the squares of this position
+    void expand_symmetric(int node_id, GameState& state, int source_id) {
+        int to_canonical = tree[source_id].symmetry;
+        int from_canonical = inverse_symmetry(tree[node_id].symmetry);
+
+        std::array <float, 65> policy{};
+
+        for (int ch = 0; ch < tree[source_id].num_edges; ++ch) {
+            const Edge& edge = child_edge(source_id, ch);
+            policy[transform_square(transform_square(edge.square, to_canonical), from_canonical)] = edge.policy_score;
+        }
+
+        expand(node_id, state, tree[source_id].evaluation_value, policy.data());
+        stats.inferences_saved++;
+    }
+
+    // expands node_id with the cached evaluation of its position, if any
+    bool expand_cached(int node_id, GameState& state) {
+        float value;
+        std::array <float, 65> policy;
+
+        if (not eval_cache or not eval_cache->lookup(state, value, policy.data())) {
+            return false;
+        }
+
+        expand(node_id, state, value, policy.data());
+        stats.inferences_saved++;
+
+        return true;
+    }
+
+    int add_node(GameState& state) {
+        int source_id = find_symmetric_evaluation(state);
+        int node_id = push_node(state);
+
+        if (source_id != -1) {
+            expand_symmetric(node_id, state, source_id);
+        }
+        else if (not is_exact_leaf(state) and not expand_cached(node_id, state)) {
+            evaluate_node(node_id, state);
+        }
+
+        return node_id;
+    }
+
+    // runs the model on the position of the node and expands it
+    void evaluate_node(int node_id, GameState& state) {
+        std::array <float, 3 * 64> board_tensor;
+        std::pair<float, std::array <float, 65>> result;
+
+        {
+            PROFILE_SCOPE(encoding);
+            state.write_tensor_representation(board_tensor.data());
+        }
+
+        {
+            PROFILE_SCOPE(inference);
+            result = model->run_inference(board_tensor.data());
+        }
+
+        auto& [value, policy] = result;
+        expand(node_id, state, value, policy.data());
+        stats.inferences++;
+        stats.inference_calls++;
+
+        if (eval_cache) {
+            eval_cache->insert(state, value, policy.data());
+        }
+    }
+
+    // The root is added unevaluated, so that a resumable search sends its
+    // evaluation to the scheduler as a batch of one leaf instead of blocking;
+    // the cache is consulted first, it may be set after the constructor.
+    bool root_pending() {
+        return tree[root_id].pending and not expand_cached(root_id, root);
+    }
+
+    // the non-resumable searches evaluate a pending root right away
+    void evaluate_root() {
+        if (root_pending()) {
+            evaluate_node(root_id, root);
+        }
+    }
+
+    // a solved root has no moves yet, they get uniform priors
+    void expand_solved_root() {
+        if (not tree[root_id].num_edges and not tree[root_id].pending and not root.is_terminal()) {
+            std::array <float, 65> uniform_policy;
+            uniform_policy.fill(1.0f);
+            expand(root_id, root, tree[root_id].evaluation_value, uniform_policy.data());
+        }
+    }
+
+    // a proven win is always played and a proven loss only when every move
+    // loses, so that no visits are spent inside solved subtrees
     int select(int parent) {
         int best_ch = -1;
+        int lost_ch = -1;
         float best_puct_score = -1e9;
         
-        float nominator = puct_factor * std::sqrtf(tree[parent].visits);
+        float nominator = puct_factor * std::sqrt((float)tree[parent].visits);
+
+        const Edge* children = edges.data() + tree[parent].first_edge;
 
-        for (int i = 0; i < tree[parent].children.size(); ++i) {
-            auto& child = tree[parent].children[i];
+        for (int i = 0; i < tree[parent].num_edges; ++i) {
+            auto& child = children[i];
 
             float exploit_score = 0.0;
             int visits = 0;
 
             if (child.node_id != -1) {
+                if (tree[child.node_id].solved == 1) {
+                    return i;
+                }
+
+                if (tree[child.node_id].solved == -1) {
+                    lost_ch = i;
+                    continue;
+                }
+
                 visits = tree[child.node_id].visits; 
                 exploit_score = tree[child.node_id].score / visits;
             }
@@ -106,51 +359,463 @@ private:
             }
         }
 
-        return best_ch;
+        return best_ch == -1 ? lost_ch : best_ch;
+    }
+
+    // a node is proven once one of its moves wins or all of them are proven;
+    // the tree-parallel search runs it concurrently with new expansions
+    void update_solved(int node_id) {
+        int best = -1;
+        bool unknown = false;
+
+        for (int ch = 0; ch < tree[node_id].num_edges; ++ch) {
+            int child_id = load_atomic(child_edge(node_id, ch).node_id, __ATOMIC_ACQUIRE);
+            int8_t solved = child_id < 0 ? UNSOLVED : load_atomic(tree[child_id].solved);
+
+            if (solved == UNSOLVED) {
+                unknown = true;
+            }
+            else {
+                best = std::max(best, (int)solved);
+            }
+        }
+
+        if (best == 1 or not unknown) {
+            store_atomic(tree[node_id].solved, (int8_t)-best);
+        }
+    }
+
+    // proves the nodes of path upwards from its end as far as the result reaches
+    void update_solved_path(const std::vector <int>& path, int path_begin) {
+        for (int i = path.size() - 1; i > path_begin and load_atomic(tree[path[i]].solved) != UNSOLVED; --i) {
+            update_solved(path[i - 1]);
+        }
     }
 
     float search_iter(GameState& state, int node_id) {
         tree[node_id].visits++;
         
-        // terminal node
-        if (not tree[node_id].children.size()) {
-            float value = -tree[node_id].evaluation_value;
+        // terminal or proven node, the exact result is backed up
+        if (tree[node_id].solved != UNSOLVED) {
+            float value = tree[node_id].solved;
             tree[node_id].score += value;
             return -value;
         }
 
         // select and apply action
         int child = select(node_id);
-        state.make_move(tree[node_id].children[child].mv);
+        state.make_move(id_to_move(child_edge(node_id, child).square));
+
+        if(child_edge(node_id, child).node_id == -1) {
+            int transposition = find_transposition(state);
+
+            if (transposition == -1) {
+                int leaf_id = add_node(state);  // may reallocate the arenas
+                child_edge(node_id, child).node_id = leaf_id;
+
+                float r = -tree.back().evaluation_value;
+                tree.back().visits++;
+                tree.back().score += r;
+
+                tree[node_id].score -= r;
 
-        if(tree[node_id].children[child].node_id == -1) {
-            tree[node_id].children[child].node_id = tree.size();
-            tree.emplace_back(state, model);
+                if (tree[leaf_id].solved != UNSOLVED) {
+                    update_solved(node_id);
+                }
 
-            float r = -tree.back().evaluation_value;
-            tree.back().visits++;
-            tree.back().score += r;
+                return r;
+            }
 
-            tree[node_id].score -= r;
+            // position already reached by another move order, continue there
+            child_edge(node_id, child).node_id = transposition;
+            stats.expansions_saved++;
 
-            return r;
+            if (tree[transposition].num_edges) {
+                stats.inferences_saved++;
+            }
         }
 
-        float r = search_iter(state, tree[node_id].children[child].node_id);
+        int child_id = child_edge(node_id, child).node_id;
+        float r = search_iter(state, child_id);
         tree[node_id].score += r;
+
+        if (tree[child_id].solved != UNSOLVED) {
+            update_solved(node_id);
+        }
         
         return -r;
     }
 
+    // adds the node to the current path and applies virtual loss to it
+    void enter_node(int node_id) {
+        batch_paths.push_back(node_id);
+        tree[node_id].visits++;
+        tree[node_id].score -= VIRTUAL_LOSS;
+    }
+
+    // value is from the perspective of the player that moved into the last node
+    void backup(int path_begin, int path_end, float value) {
+        for (int i = path_end - 1; i >= path_begin; --i) {
+            tree[batch_paths[i]].score += value + VIRTUAL_LOSS;
+            value = -value;
+        }
+    }
+
+    void revert_path(int path_begin) {
+        for (int i = path_begin; i < (int)batch_paths.size(); ++i) {
+            tree[batch_paths[i]].visits--;
+            tree[batch_paths[i]].score += VIRTUAL_LOSS;
+        }
+
+        batch_paths.resize(path_begin);
+    }
+
+    // descends from the root under virtual loss; a new leaf is either queued
+    // for evaluation or, when terminal, backed up immediately. Returns false
+    // if the descent ran into a leaf that is already waiting for evaluation.
+    bool collect_leaf(GameState& state) {
+        int path_begin = batch_paths.size();
+        int node_id = root_id;
+
+        while (true) {
+            if (tree[node_id].pending) {
+                revert_path(path_begin);
+                return false;
+            }
+
+            enter_node(node_id);
+
+            // terminal or proven node, the exact result is backed up
+            if (tree[node_id].solved != UNSOLVED) {
+                backup(path_begin, batch_paths.size(), tree[node_id].solved);
+                update_solved_path(batch_paths, path_begin);
+                return true;
+            }
+
+            int child = select(node_id);
+            state.make_move(id_to_move(child_edge(node_id, child).square));
+
+            if (child_edge(node_id, child).node_id == -1) {
+                int transposition = find_transposition(state);
+
+                if (transposition != -1) {
+                    child_edge(node_id, child).node_id = transposition;
+                    stats.expansions_saved++;
+
+                    if (tree[transposition].num_edges or tree[transposition].pending) {
+                        stats.inferences_saved++;
+                    }
+                }
+                else {
+                    int leaf_id = add_pending_node(state);
+                    child_edge(node_id, child).node_id = leaf_id;
+                    enter_node(leaf_id);
+
+                    if (not tree[leaf_id].pending) {
+                        backup(path_begin, batch_paths.size(), -tree[leaf_id].evaluation_value);
+                        update_solved_path(batch_paths, path_begin);
+                        return true;
+                    }
+
+                    float* tensor = batch_tensors.data() + pending_leaves.size() * 3 * 64;
+
+                    {
+                        PROFILE_SCOPE(encoding);
+                        state.write_tensor_representation(tensor);
+                    }
+
+                    pending_leaves.push_back(PendingLeaf{state, path_begin, (int)batch_paths.size()});
+                    return true;
+                }
+            }
+
+            node_id = child_edge(node_id, child).node_id;
+        }
+    }
+
+    int add_pending_node(GameState& state) {
+        int source_id = find_symmetric_evaluation(state);
+        int node_id = push_node(state);
+
+        if (source_id != -1) {
+            expand_symmetric(node_id, state, source_id);
+        }
+        else if (not is_exact_leaf(state)) {
+            tree[node_id].pending = not expand_cached(node_id, state);
+        }
+
+        return node_id;
+    }
+
+    // runs up to max_leaves descents, returns the number of simulations that
+    // were completed; the new leaves wait in batch_tensors for evaluation
+    int collect_batch(int max_leaves) {
+        PROFILE_SCOPE(selection);
+        batch_paths.clear();
+        pending_leaves.clear();
+        batch_tensors.resize(max_leaves * 3 * 64);
+        batch_values.resize(max_leaves);
+        batch_policies.resize(max_leaves * 65);
+
+        int simulations = 0;
+
+        for (int i = 0; i < max_leaves and tree[root_id].solved == UNSOLVED; ++i) {
+            GameState state_copy = root;
+
+            if (collect_leaf(state_copy)) {
+                simulations++;
+            }
+        }
+
+        return simulations;
+    }
+
+    // expands the collected leaves with the results in batch_values and batch_policies
+    void apply_batch() {
+        PROFILE_SCOPE(backup);
+        int leaves = pending_leaves.size();
+        PROFILE_COUNT(leaf_batches, 1);
+        PROFILE_COUNT(leaf_batch_positions, leaves);
+        stats.inferences += leaves;
+        stats.inference_calls++;
+
+        for (int i = 0; i < leaves; ++i) {
+            auto& leaf = pending_leaves[i];
+            int leaf_id = batch_paths[leaf.path_end - 1];
+
+            expand(leaf_id, leaf.state, batch_values[i], batch_policies.data() + i * 65);
+            backup(leaf.path_begin, leaf.path_end, -tree[leaf_id].evaluation_value);
+
+            if (eval_cache) {
+                eval_cache->insert(leaf.state, batch_values[i], batch_policies.data() + i * 65);
+            }
+        }
+
+        pending_leaves.clear();
+    }
+
+    int select_parallel(int parent) {
+        int best_ch = -1;
+        int lost_ch = -1;
+        float best_puct_score = -1e9;
+
+        float nominator = puct_factor * std::sqrt((float)load_atomic(tree[parent].visits));
+        const Edge* children = edges.data() + tree[parent].first_edge;
+
+        for (int i = 0; i < tree[parent].num_edges; ++i) {
+            int child_id = load_atomic(children[i].node_id, __ATOMIC_ACQUIRE);
+
+            float exploit_score = 0.0;
+            int visits = 0;
+
+            if (child_id >= 0) {
+                int8_t solved = load_atomic(tree[child_id].solved);
+
+                if (solved == 1) {
+                    return i;
+                }
+
+                if (solved == -1) {
+                    lost_ch = i;
+                    continue;
+                }
+
+                visits = load_atomic(tree[child_id].visits);
+                exploit_score = load_atomic(tree[child_id].score) / visits;
+            }
+
+            float puct_score = exploit_score + children[i].policy_score * nominator / (1 + visits);
+
+            if (puct_score > best_puct_score) {
+                best_ch = i;
+                best_puct_score = puct_score;
+            }
+        }
+
+        return best_ch == -1 ? lost_ch : best_ch;
+    }
+
+    void enter_parallel(int node_id, std::vector <int>& path) {
+        path.push_back(node_id);
+        add_atomic(tree[node_id].visits, 1);
+        add_atomic(tree[node_id].score, -VIRTUAL_LOSS);
+    }
+
+    void revert_parallel(std::vector <int>& path) {
+        for (int node_id : path) {
+            add_atomic(tree[node_id].visits, -1);
+            add_atomic(tree[node_id].score, VIRTUAL_LOSS);
+        }
+    }
+
+    // evaluates a node claimed by this thread; other threads see it as
+    // pending until its edges are published
+    void evaluate_parallel(int node_id, GameState& state, SearchStats& thread_stats) {
+        if (is_exact_leaf(state)) {
+            tree[node_id].evaluation_value = evaluate_exact(state, thread_stats);
+            store_atomic(tree[node_id].solved, (int8_t)-tree[node_id].evaluation_value);
+        }
+        else {
+            float value;
+            std::array <float, 65> policy;
+
+            if (eval_cache and eval_cache->lookup(state, value, policy.data())) {
+                thread_stats.inferences_saved++;
+            }
+            else {
+                std::array <float, 3 * 64> board_tensor;
+
+                {
+                    PROFILE_SCOPE(encoding);
+                    state.write_tensor_representation(board_tensor.data());
+                }
+
+                {
+                    PROFILE_SCOPE(inference);
+                    std::tie(value, policy) = model->run_inference(board_tensor.data());
+                }
+
+                thread_stats.inferences++;
+                thread_stats.inference_calls++;
+
+                if (eval_cache) {
+                    eval_cache->insert(state, value, policy.data());
+                }
+            }
+
+            const MoveList& valid_moves = state.get_move_list();
+            uint32_t first_edge = next_edge.fetch_add(valid_moves.size());
+            write_edges(edges.data() + first_edge, valid_moves, policy.data());
+
+            tree[node_id].evaluation_value = value;
+            tree[node_id].first_edge = first_edge;
+            tree[node_id].num_edges = valid_moves.size();
+        }
+
+        store_atomic(tree[node_id].pending, false, __ATOMIC_RELEASE);
+    }
+
+    // one descent; returns false if it ran into a node that another thread
+    // is still evaluating, after undoing its virtual loss
+    bool simulate_parallel(std::vector <int>& path, SearchStats& thread_stats) {
+        GameState state = root;
+        int node_id = root_id;
+        path.clear();
+
+        while (true) {
+            if (load_atomic(tree[node_id].pending, __ATOMIC_ACQUIRE)) {
+                revert_parallel(path);
+                return false;
+            }
+
+            enter_parallel(node_id, path);
+
+            // terminal or proven node
+            if (load_atomic(tree[node_id].solved) != UNSOLVED) {
+                break;
+            }
+
+            Edge& edge = child_edge(node_id, select_parallel(node_id));
+            state.make_move(id_to_move(edge.square));
+
+            if (compare_exchange_atomic(edge.node_id, -1, EXPANDING)) {
+                int leaf_id = next_node.fetch_add(1);
+                tree[leaf_id] = MctsTreeNode{1, -VIRTUAL_LOSS, 0.0f, 0, 0, true, 0, UNSOLVED};
+                path.push_back(leaf_id);
+                store_atomic(edge.node_id, leaf_id, __ATOMIC_RELEASE);
+
+                evaluate_parallel(leaf_id, state, thread_stats);
+                thread_stats.expansions++;
+
+                node_id = leaf_id;
+                break;
+            }
+
+            // another thread has just claimed this child, its id follows shortly
+            int child_id;
+            while ((child_id = load_atomic(edge.node_id, __ATOMIC_ACQUIRE)) == EXPANDING) {
+                std::this_thread::yield();
+            }
+
+            node_id = child_id;
+        }
+
+        // value is from the perspective of the player that moved into the last node
+        int8_t solved = load_atomic(tree[node_id].solved);
+        float value = solved != UNSOLVED ? solved : -tree[node_id].evaluation_value;
+
+        for (int i = path.size() - 1; i >= 0; --i) {
+            add_atomic(tree[path[i]].score, value + VIRTUAL_LOSS);
+            value = -value;
+        }
+
+        update_solved_path(path, 0);
+
+        return true;
+    }
+
+    void search_worker(SearchStats& thread_stats) {
+        std::vector <int> path;
+
+        while (simulations_started.fetch_add(1) < iters_per_move and load_atomic(tree[root_id].solved) == UNSOLVED) {
+            while (not simulate_parallel(path, thread_stats)) {
+                std::this_thread::yield();
+            }
+
+            thread_stats.simulations++;
+        }
+    }
+
+    // runs iters_per_move simulations on num_threads threads sharing the tree,
+    // each thread evaluates its own leaves; new nodes are not entered into the
+    // transposition table
+    void search_parallel() {
+        int node_base = tree.size();
+        uint32_t edge_base = edges.size();
+
+        // every simulation adds at most one node
+        tree.resize(node_base + iters_per_move);
+        edges.resize(edge_base + iters_per_move * MoveList::MAX_MOVES);
+        next_node = node_base;
+        next_edge = edge_base;
+        simulations_started = 0;
+
+        std::vector <SearchStats> thread_stats(num_threads);
+        std::vector <std::thread> threads;
+
+        for (int i = 0; i < num_threads; ++i) {
+            threads.emplace_back(&AlphaZeroAgent::search_worker, this, std::ref(thread_stats[i]));
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        tree.resize(next_node);
+        edges.resize(next_edge);
+
+        for (auto& thread_stat : thread_stats) {
+            stats.simulations += thread_stat.simulations;
+            stats.expansions += thread_stat.expansions;
+            stats.inferences += thread_stat.inferences;
+            stats.inferences_saved += thread_stat.inferences_saved;
+            stats.inference_calls += thread_stat.inference_calls;
+            stats.solved += thread_stat.solved;
+        }
+    }
+
 public:
     AlphaZeroAgent(std::string model_path, float puct_factor, int iters_per_move)
         : AgentBase(),
           puct_factor(puct_factor),
           iters_per_move(iters_per_move),
           move_cnt(0),
-          model(model_path) {
-        tree.reserve(DEFAULT_SIZE);
-        tree.emplace_back(root, model);
+          owned_model(std::make_unique<OnnxModel>(model_path)),
+          model(owned_model.get()) {
+        // one node per simulation, arenas grow from there if needed
+        tree.reserve(iters_per_move + 1);
+        edges.reserve(8 * (iters_per_move + 1));
+        add_pending_node(root);
     }
 
     AlphaZeroAgent(std::string model_path, float puct_factor, int iters_per_move, uint_fast32_t seed)
@@ -158,36 +823,214 @@ public:
         generator.seed(seed);
     }
 
+    // evaluates positions with a model shared with other agents, e.g. an InferenceClient
+    AlphaZeroAgent(ModelBase& shared_model, float puct_factor, int iters_per_move)
+        : AgentBase(),
+          puct_factor(puct_factor),
+          iters_per_move(iters_per_move),
+          move_cnt(0),
+          model(&shared_model) {
+        // one node per simulation, arenas grow from there if needed
+        tree.reserve(iters_per_move + 1);
+        edges.reserve(8 * (iters_per_move + 1));
+        add_pending_node(root);
+    }
+
+    AlphaZeroAgent(ModelBase& shared_model, float puct_factor, int iters_per_move, uint_fast32_t seed)
+        : AlphaZeroAgent(shared_model, puct_factor, iters_per_move) {
+        generator.seed(seed);
+    }
+
+    // merges transpositions into a DAG; with canonical keys positions that
+    // are symmetric to an evaluated one reuse its evaluation instead of
+    // running inference. Enable before the first select_move
+    void set_transpositions(bool enabled, bool canonical = false) {
+        use_transpositions = enabled;
+        canonical_transpositions = enabled and canonical;
+        transpositions.clear();
+
+        tree[root_id].symmetry = position_symmetry(root);
+
+        if (use_transpositions) {
+            add_transposition(root, root_id);
+        }
+    }
+
+    // number of leaves evaluated together in one inference call, 1 disables batching
+    void set_batch_size(int size) {
+        batch_size = std::max(size, 1);
+    }
+
+    // threads sharing one tree in select_move, each evaluating its own leaves;
+    // takes precedence over the batch size, 1 keeps the sequential search
+    void set_num_threads(int threads) {
+        num_threads = std::max(threads, 1);
+    }
+
+    // evaluates positions with at most empties empty squares by the endgame
+    // solver, their exact values are backed up in place of model evaluations
+    // and proven wins and losses are propagated up the tree, where they decide
+    // the selection; 0 disables
+    void set_endgame_solver(int empties) {
+        solver_empties = std::max(empties, 0);
+    }
+
+    // looks up new positions in the cache before evaluating them and stores
+    // the model results there, see shared_eval_cache; nullptr disables
+    void set_eval_cache(std::shared_ptr <EvalCache> cache) {
+        eval_cache = std::move(cache);
+    }
+
+    const SearchStats& get_search_stats() const {
+        return stats;
+    }
+
+    size_t get_tree_size() const {
+        return tree.size();
+    }
+
     virtual std::pair<move, std::vector<std::pair<move, int>>> select_move(GameState& state) override {
-        for (int i = 0; i < iters_per_move; ++i) {
-            GameState state_copy = root;
-            search_iter(state_copy, root_id);
+        PROFILE_SCOPE(search);
+        TRACE_SCOPE("select_move");
+        begin_search();
+        evaluate_root();
+
+        if (num_threads > 1) {
+            search_parallel();
         }
+        else if (batch_size == 1) {
+            while (not search_done()) {
+                GameState state_copy = root;
+                search_iter(state_copy, root_id);
+                stats.simulations++;
+            }
+        }
+        else {
+            while (not search_done()) {
+                int leaves = prepare_batch();
+
+                if (leaves) {
+                    {
+                        PROFILE_SCOPE(inference);
+                        model->run_batch_inference(batch_input(), leaves, batch_value_output(), batch_policy_output());
+                    }
 
+                    finish_batch();
+                }
+            }
+        }
+
+        return finish_search();
+    }
+
+    // Resumable form of select_move for schedulers that evaluate the leaves
+    // themselves: begin_search, then prepare_batch / finish_batch until
+    // search_done, then finish_search.
+    void begin_search() {
+        stats = SearchStats();
+        search_start = std::chrono::steady_clock::now();
+        expand_solved_root();
+
+        // proven again below once the root moves are
+        tree[root_id].solved = UNSOLVED;
+    }
+
+    // a proven root needs no more simulations
+    bool search_done() const {
+        return stats.simulations >= iters_per_move or tree[root_id].solved != UNSOLVED;
+    }
+
+    // returns the number of leaves written to batch_input, may be 0 when
+    // every descent ended in a terminal position; an unevaluated root goes
+    // out alone before the first descent
+    int prepare_batch() {
+        TraceScope trace("prepare_batch");
+
+        if (root_pending()) {
+            batch_tensors.resize(std::max(batch_tensors.size(), (size_t)3 * 64));
+            batch_values.resize(std::max(batch_values.size(), (size_t)1));
+            batch_policies.resize(std::max(batch_policies.size(), (size_t)65));
+            root.write_tensor_representation(batch_tensors.data());
+            evaluating_root = true;
+
+            trace.set_count(1);
+            return 1;
+        }
+
+        stats.simulations += collect_batch(std::min(batch_size, iters_per_move - stats.simulations));
+        trace.set_count(pending_leaves.size());
+        return pending_leaves.size();
+    }
+
+    const float* batch_input() const {
+        return batch_tensors.data();
+    }
+
+    float* batch_value_output() {
+        return batch_values.data();
+    }
+
+    float* batch_policy_output() {
+        return batch_policies.data();
+    }
+
+    void finish_batch() {
+        TRACE_SCOPE("finish_batch", evaluating_root ? 1 : pending_leaves.size());
+
+        if (evaluating_root) {
+            evaluating_root = false;
+            expand(root_id, root, batch_values[0], batch_policies.data());
+            stats.inferences++;
+            stats.inference_calls++;
+
+            if (eval_cache) {
+                eval_cache->insert(root, batch_values[0], batch_policies.data());
+            }
+
+            return;
+        }
+
+        apply_batch();
+    }
+
+    std::pair<move, std::vector<std::pair<move, int>>> finish_search() {
+        stats.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - search_start).count();
+
+        PROFILE_COUNT(simulations, stats.simulations);
+        PROFILE_COUNT(expansions, stats.expansions);
+        PROFILE_COUNT(inferences, stats.inferences);
+        PROFILE_COUNT(evaluations_saved, stats.inferences_saved);
+        PROFILE_COUNT(solved, stats.solved);
+        PROFILE_MAX(tree_nodes_max, tree.size());
+
+        // proven wins come first and proven losses last, visits decide in between
         int best_move = 0;
+        int best_result = -1;
         float best_visits = 0;
-        std::vector <std::pair<move, int>> policy(tree[root_id].children.size());
+        std::vector <std::pair<move, int>> policy(tree[root_id].num_edges);
 
-        for (int ch = 0; ch < tree[root_id].children.size(); ++ch) {
-            auto child = tree[root_id].children[ch];
+        for (int ch = 0; ch < tree[root_id].num_edges; ++ch) {
+            const Edge& child = child_edge(root_id, ch);
 
             if (child.node_id != -1) {
                 int visits = tree[child.node_id].visits;
-                policy[ch] = {child.mv, visits};
+                int result = tree[child.node_id].solved == UNSOLVED ? 0 : tree[child.node_id].solved;
+                policy[ch] = {id_to_move(child.square), visits};
 
-                if (best_visits < visits) {
+                if (best_result < result or (best_result == result and best_visits < visits)) {
+                    best_result = result;
                     best_visits = visits;
                     best_move = ch;
                 }
             }
             else {
-                policy[ch] = {child.mv, 0};
+                policy[ch] = {id_to_move(child.square), 0};
             }
         }
 
-        if (move_cnt > BEST_MOVE_THRESH) {
+        if (move_cnt > BEST_MOVE_THRESH or best_result == 1) {
             return {
-                tree[root_id].children[best_move].mv,
+                id_to_move(child_edge(root_id, best_move).square),
                 policy
             };
         }
@@ -206,17 +1049,36 @@ public:
     }
 
     virtual void make_move(const move& move) override {
+        PROFILE_SCOPE(advance_root);
+        expand_solved_root();
         root.make_move(move);
         ++move_cnt;
 
-        for (auto& ch : tree[root_id].children) {
-            if (ch.mv == move) {
-                if (ch.node_id == -1) {
-                    ch.node_id = tree.size();
-                    tree.emplace_back(root, model);
+        // the root was never searched, e.g. the opponent moved first
+        if (tree[root_id].pending) {
+            tree.clear();
+            edges.clear();
+            transpositions.clear();
+            root_id = add_pending_node(root);
+            return;
+        }
+
+        for (int ch = 0; ch < tree[root_id].num_edges; ++ch) {
+            if (child_edge(root_id, ch).square == move_to_id(move)) {
+                if (child_edge(root_id, ch).node_id == -1) {
+                    int node_id = find_transposition(root);
+
+                    if (node_id == -1) {
+                        node_id = add_pending_node(root);  // may reallocate the arenas
+                    }
+
+                    child_edge(root_id, ch).node_id = node_id;
                 }
 
-                root_id = ch.node_id;
+                root_id = child_edge(root_id, ch).node_id;
+
+                // keep only the subtree under the new root
+                root_id = compact_tree(tree, edges, root_id, transpositions, iters_per_move + 1, 8 * (iters_per_move + 1));
                 return;
             }
         }
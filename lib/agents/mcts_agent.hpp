@@ -2,36 +2,71 @@
 #define MCTS_AGENT
 
 #include "agents/agent_base.hpp"
+#include "agents/tree_compaction.hpp"
+#include "atomic_utils.hpp"
+#include "endgame_solver.hpp"
 #include "othello.hpp"
+#include "playout.hpp"
+#include "simd_playout.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <ctime>
+#include <memory>
 #include <random>
+#include <thread>
+#include <unordered_map>
 #include <cmath>
 #include <stdexcept>
 
 class MctsAgent : public AgentBase {
 private:
-    const int DEFAULT_SIZE = 2000000;
+    // children of every node are stored contiguously in one edge arena
+    struct Edge {
+        int node_id;     // -1 until the child is expanded
+        uint8_t square;  // move_to_id of the move
+    };
 
     struct MctsTreeNode {
-        std::vector <std::pair <move, int> > children;
         int visits;
         int score;
+        uint32_t first_edge;
+        uint8_t num_edges;
+        int8_t solved;  // proven result for the player that moved here, or UNSOLVED
+    };
 
-        MctsTreeNode(GameState& state) {
-            auto valid_moves = state.get_valid_moves();
-            children.reserve(64);
-
-            for (auto& move : valid_moves) {
-                children.emplace_back(move, -1);
-            }
+    static constexpr int8_t UNSOLVED = 2;
 
-            visits = 0;
-            score = 0;
-        }
-    };
     std::vector <MctsTreeNode> tree;
+    std::vector <Edge> edges;
+
+    // position hash -> node id, turns the tree into a DAG when enabled
+    bool use_transpositions = false;
+    std::unordered_map <uint64_t, int> transpositions;
+    SearchStats stats;
+
+    // tree-parallel search, nodes and edges are taken from preallocated arena slots
+    static constexpr int EXPANDING = -2;  // node_id of an edge claimed by a thread
+    const int VIRTUAL_LOSS = 1;
+    int num_threads = 1;
+    std::atomic <int> next_node{0};
+    std::atomic <uint32_t> next_edge{0};
+    std::atomic <int> simulations_started{0};
+
+    // leaf-parallel search, several playouts from every new leaf
+    int playouts_per_leaf = 1;
+    std::unique_ptr <PlayoutPool> playout_pool;
+    PlayoutLanes playout_lanes;  // batched playouts when there is no pool
+    std::vector <int> playout_results;
+
+    // root-parallel search, independent trees whose root statistics are merged
+    std::vector <std::unique_ptr <MctsAgent>> root_workers;
+
+    // positions with at most this many empty squares are solved exactly, 0 disables
+    int solver_empties = 0;
 
     GameState root;
     int root_id = 0;
@@ -39,25 +74,63 @@ private:
     int iters_per_move;
     std::mt19937 generator;
 
-    int rollout(GameState& state, int player) {
-        while (not state.is_terminal()) {
-            auto valid_moves = state.get_valid_moves();
-            int move_id = generator() % valid_moves.size();
+    int find_transposition(const GameState& state) const {
+        if (not use_transpositions) {
+            return -1;
+        }
+
+        auto it = transpositions.find(state.hash);
+        return it == transpositions.end() ? -1 : it->second;
+    }
+
+    Edge& child_edge(int node_id, int ch) {
+        return edges[tree[node_id].first_edge + ch];
+    }
 
-            state.make_move(valid_moves[move_id]);
+    int add_node(GameState& state) {
+        const MoveList& valid_moves = state.get_move_list();
+        tree.push_back(MctsTreeNode{0, 0, (uint32_t)edges.size(), (uint8_t)valid_moves.size(), UNSOLVED});
+
+        for (auto& move : valid_moves) {
+            edges.push_back(Edge{-1, (uint8_t)move_to_id(move)});
         }
 
-        auto scores = state.get_scores();
+        stats.expansions++;
 
-        if (scores.first < scores.second) {
-            return player == 1 ? -1 : 1;
+        if (solver_empties and count_empties(state) <= solver_empties) {
+            tree.back().solved = -thread_endgame_solver().solve_result(state);
+            stats.solved++;
         }
 
-        if (scores.first > scores.second) {
-            return player == 1 ? 1 : -1;
+        if (use_transpositions) {
+            transpositions.emplace(state.hash, tree.size() - 1);
         }
 
-        return 0;
+        return tree.size() - 1;
+    }
+
+    // sum of playouts_per_leaf playout results, one visit is counted per playout
+    int rollout(GameState& state, int player) {
+        stats.playouts += playouts_per_leaf;
+
+        if (playout_pool) {
+            return playout_pool->run(state, player, playouts_per_leaf);
+        }
+
+        if (playouts_per_leaf == 1) {
+            return random_playout(state, player, generator);
+        }
+
+        playout_results.resize(playouts_per_leaf);
+        playout_lanes.play(state, player, playouts_per_leaf, playout_results.data());
+
+        int sum = 0;
+
+        for (int result : playout_results) {
+            sum += result;
+        }
+
+        return sum;
     }
 
     int select(int parent) {
@@ -66,16 +139,16 @@ private:
         
         float nominator = std::log(tree[parent].visits);
 
-        for (int i = 0; i < tree[parent].children.size(); ++i) {
-            auto& action = tree[parent].children[i];
+        const Edge* children = edges.data() + tree[parent].first_edge;
 
-            if (action.second == -1) {
+        for (int i = 0; i < tree[parent].num_edges; ++i) {
+            if (children[i].node_id == -1) {
                 return i;
             }
 
-            auto& child = tree[action.second];
+            auto& child = tree[children[i].node_id];
 
-            float uct_score = child.score / (float)child.visits + uct_factor * std::sqrtf(nominator / (float)child.visits);
+            float uct_score = child.score / (float)child.visits + uct_factor * std::sqrt(nominator / (float)child.visits);
 
             if (uct_score > best_uct_score) {
                 best_ch = i;
@@ -86,11 +159,41 @@ private:
         return best_ch;
     }
 
+    // a node is proven once one of its moves wins or all of them are proven;
+    // the tree-parallel search runs it concurrently with new expansions
+    void update_solved(int node_id) {
+        int best = -1;
+        bool unknown = false;
+
+        for (int ch = 0; ch < tree[node_id].num_edges; ++ch) {
+            int child_id = load_atomic(child_edge(node_id, ch).node_id, __ATOMIC_ACQUIRE);
+            int8_t solved = child_id < 0 ? UNSOLVED : load_atomic(tree[child_id].solved);
+
+            if (solved == UNSOLVED) {
+                unknown = true;
+            }
+            else {
+                best = std::max(best, (int)solved);
+            }
+        }
+
+        if (best == 1 or not unknown) {
+            store_atomic(tree[node_id].solved, (int8_t)-best);
+        }
+    }
+
     int search_iter(GameState& state, int node_id) {
-        tree[node_id].visits++;
+        tree[node_id].visits += playouts_per_leaf;
+
+        // the exact result replaces the playouts
+        if (tree[node_id].solved != UNSOLVED) {
+            int value = tree[node_id].solved * playouts_per_leaf;
+            tree[node_id].score += value;
+            return -value;
+        }
         
         // terminal node
-        if (not tree[node_id].children.size()) {
+        if (not tree[node_id].num_edges) {
             int value = rollout(state, state.current_player ^ 3);
             tree[node_id].score += value;
             return -value;
@@ -98,58 +201,385 @@ private:
 
         // select and apply action
         int child = select(node_id);
-        state.make_move(tree[node_id].children[child].first);
+        state.make_move(id_to_move(child_edge(node_id, child).square));
+
+        if(child_edge(node_id, child).node_id == -1) {
+            int transposition = find_transposition(state);
+
+            if (transposition == -1) {
+                int leaf_id = add_node(state);  // may reallocate the arenas
+                child_edge(node_id, child).node_id = leaf_id;
 
-        if(tree[node_id].children[child].second == -1) {
-            tree[node_id].children[child].second = tree.size();
-            tree.emplace_back(state);
+                int r = tree[leaf_id].solved != UNSOLVED
+                    ? tree[leaf_id].solved * playouts_per_leaf
+                    : rollout(state, state.current_player ^ 3);
+                tree.back().visits += playouts_per_leaf;
+                tree.back().score += r;
 
-            int r = rollout(state, state.current_player ^ 3);
-            tree.back().visits++;
-            tree.back().score += r;
+                tree[node_id].score -= r;
 
-            tree[node_id].score -= r;
+                if (tree[leaf_id].solved != UNSOLVED) {
+                    update_solved(node_id);
+                }
+
+                return r;
+            }
 
-            return r;
+            // position already reached by another move order, continue there
+            child_edge(node_id, child).node_id = transposition;
+            stats.expansions_saved++;
         }
 
-        int r = search_iter(state, tree[node_id].children[child].second);
+        int child_id = child_edge(node_id, child).node_id;
+        int r = search_iter(state, child_id);
         tree[node_id].score += r;
+
+        if (tree[child_id].solved != UNSOLVED) {
+            update_solved(node_id);
+        }
         
         return -r;
     }
 
+    int select_parallel(int parent) {
+        int best_ch = -1;
+        float best_uct_score = -1e9;
+
+        float nominator = std::log(load_atomic(tree[parent].visits));
+        const Edge* children = edges.data() + tree[parent].first_edge;
+
+        for (int i = 0; i < tree[parent].num_edges; ++i) {
+            int child_id = load_atomic(children[i].node_id, __ATOMIC_ACQUIRE);
+
+            if (child_id == -1) {
+                return i;
+            }
+
+            if (child_id == EXPANDING) {
+                continue;
+            }
+
+            float visits = load_atomic(tree[child_id].visits);
+            float uct_score = load_atomic(tree[child_id].score) / visits + uct_factor * std::sqrt(nominator / visits);
+
+            if (uct_score > best_uct_score) {
+                best_ch = i;
+                best_uct_score = uct_score;
+            }
+        }
+
+        // every child is being expanded right now, wait for the first one
+        return best_ch == -1 ? 0 : best_ch;
+    }
+
+    void enter_parallel(int node_id, std::vector <int>& path) {
+        path.push_back(node_id);
+        add_atomic(tree[node_id].visits, 1);
+        add_atomic(tree[node_id].score, -VIRTUAL_LOSS);
+    }
+
+    // the new node is published with the visit and virtual loss of its creator
+    int allocate_node(GameState& state) {
+        const MoveList& valid_moves = state.get_move_list();
+        int node_id = next_node.fetch_add(1);
+        uint32_t first_edge = next_edge.fetch_add(valid_moves.size());
+
+        for (int i = 0; i < valid_moves.size(); ++i) {
+            edges[first_edge + i] = Edge{-1, (uint8_t)move_to_id(valid_moves[i])};
+        }
+
+        tree[node_id] = MctsTreeNode{1, -VIRTUAL_LOSS, first_edge, (uint8_t)valid_moves.size(), UNSOLVED};
+
+        if (solver_empties and count_empties(state) <= solver_empties) {
+            tree[node_id].solved = -thread_endgame_solver().solve_result(state);
+        }
+
+        return node_id;
+    }
+
+    void search_worker(uint_fast32_t seed, SearchStats& thread_stats) {
+        std::mt19937 rng(seed);
+        std::vector <int> path;
+
+        while (simulations_started.fetch_add(1) < iters_per_move and load_atomic(tree[root_id].solved) == UNSOLVED) {
+            GameState state = root;
+            int node_id = root_id;
+            int value = 0;
+
+            path.clear();
+            enter_parallel(node_id, path);
+
+            while (true) {
+                // the exact result replaces the playout
+                int8_t solved = load_atomic(tree[node_id].solved);
+
+                if (solved != UNSOLVED) {
+                    value = solved;
+                    break;
+                }
+
+                // terminal node
+                if (not tree[node_id].num_edges) {
+                    value = random_playout(state, state.current_player ^ 3, rng);
+                    thread_stats.playouts++;
+                    break;
+                }
+
+                Edge& edge = child_edge(node_id, select_parallel(node_id));
+                state.make_move(id_to_move(edge.square));
+
+                if (compare_exchange_atomic(edge.node_id, -1, EXPANDING)) {
+                    int leaf_id = allocate_node(state);
+                    path.push_back(leaf_id);
+                    store_atomic(edge.node_id, leaf_id, __ATOMIC_RELEASE);
+                    thread_stats.expansions++;
+
+                    if (tree[leaf_id].solved != UNSOLVED) {
+                        value = tree[leaf_id].solved;
+                        thread_stats.solved++;
+                        break;
+                    }
+
+                    value = random_playout(state, state.current_player ^ 3, rng);
+                    thread_stats.playouts++;
+                    break;
+                }
+
+                // another thread is expanding this child, the window is short
+                int child_id;
+                while ((child_id = load_atomic(edge.node_id, __ATOMIC_ACQUIRE)) == EXPANDING) {
+                    std::this_thread::yield();
+                }
+
+                node_id = child_id;
+                enter_parallel(node_id, path);
+            }
+
+            // value is from the perspective of the player that moved into the last node
+            for (int i = path.size() - 1; i >= 0; --i) {
+                add_atomic(tree[path[i]].score, value + VIRTUAL_LOSS);
+                value = -value;
+            }
+
+            // proves the path upwards as far as the result of its last node reaches
+            for (int i = path.size() - 1; i > 0 and load_atomic(tree[path[i]].solved) != UNSOLVED; --i) {
+                update_solved(path[i - 1]);
+            }
+
+            thread_stats.simulations++;
+        }
+    }
+
+    // runs iters_per_move simulations on num_threads threads sharing the tree;
+    // new nodes are not entered into the transposition table
+    void search_parallel() {
+        int node_base = tree.size();
+        uint32_t edge_base = edges.size();
+
+        // every simulation adds at most one node
+        tree.resize(node_base + iters_per_move);
+        edges.resize(edge_base + iters_per_move * MoveList::MAX_MOVES);
+        next_node = node_base;
+        next_edge = edge_base;
+        simulations_started = 0;
+
+        std::vector <SearchStats> thread_stats(num_threads);
+        std::vector <std::thread> threads;
+
+        for (int i = 0; i < num_threads; ++i) {
+            threads.emplace_back(&MctsAgent::search_worker, this, generator(), std::ref(thread_stats[i]));
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        tree.resize(next_node);
+        edges.resize(next_edge);
+
+        for (auto& thread_stat : thread_stats) {
+            stats.simulations += thread_stat.simulations;
+            stats.expansions += thread_stat.expansions;
+            stats.playouts += thread_stat.playouts;
+            stats.solved += thread_stat.solved;
+        }
+    }
+
+    // runs every root worker on its own thread and sums their root children
+    // into this tree's root, which holds the same moves in the same order
+    void search_root_parallel(GameState& state) {
+        std::vector <std::thread> threads;
+
+        for (auto& worker : root_workers) {
+            threads.emplace_back([&worker, &state] {
+                GameState state_copy = state;
+                worker->select_move(state_copy);
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        for (int ch = 0; ch < tree[root_id].num_edges; ++ch) {
+            int visits = 0, score = 0;
+            int8_t solved = UNSOLVED;
+
+            for (auto& worker : root_workers) {
+                const Edge& edge = worker->child_edge(worker->root_id, ch);
+
+                if (edge.node_id != -1) {
+                    visits += worker->tree[edge.node_id].visits;
+                    score += worker->tree[edge.node_id].score;
+                    solved = std::min(solved, worker->tree[edge.node_id].solved);
+                }
+            }
+
+            if (visits and child_edge(root_id, ch).node_id == -1) {
+                GameState child_state = root;
+                child_state.make_move(id_to_move(child_edge(root_id, ch).square));
+                int node_id = add_node(child_state);  // may reallocate the arenas
+                child_edge(root_id, ch).node_id = node_id;
+            }
+
+            if (visits) {
+                tree[child_edge(root_id, ch).node_id].visits = visits;
+                tree[child_edge(root_id, ch).node_id].score = score;
+                tree[child_edge(root_id, ch).node_id].solved = solved;
+            }
+        }
+
+        for (auto& worker : root_workers) {
+            const SearchStats& worker_stats = worker->get_search_stats();
+            stats.simulations += worker_stats.simulations;
+            stats.expansions += worker_stats.expansions;
+            stats.playouts += worker_stats.playouts;
+        }
+    }
+
 public:
     MctsAgent(float uct_factor, int iters_per_move)
         : uct_factor(uct_factor),
           iters_per_move(iters_per_move)
     {
-        tree.reserve(DEFAULT_SIZE);
-        tree.emplace_back(root);
+        // one node per simulation, arenas grow from there if needed
+        tree.reserve(iters_per_move + 1);
+        edges.reserve(8 * (iters_per_move + 1));
+        add_node(root);
     }
 
     MctsAgent(float uct_factor, int iters_per_move, uint_fast32_t seed)
         : MctsAgent(uct_factor, iters_per_move)
     {
         generator.seed(seed);
+        playout_lanes.seed(seed);
+    }
+
+    // merges transpositions into a DAG; enable before the first select_move
+    void set_transpositions(bool enabled) {
+        use_transpositions = enabled;
+        transpositions.clear();
+
+        if (use_transpositions) {
+            transpositions.emplace(root.hash, root_id);
+        }
+
+        for (auto& worker : root_workers) {
+            worker->set_transpositions(enabled);
+        }
+    }
+
+    // threads sharing one tree in select_move, 1 keeps the sequential search
+    void set_num_threads(int threads) {
+        num_threads = std::max(threads, 1);
+    }
+
+    // runs playouts games from every new leaf of the sequential search and
+    // backs up their sum, on threads helper threads when threads > 1 and
+    // otherwise several games at once in the vectorized playout lanes
+    void set_leaf_parallel(int playouts, int threads = 1) {
+        playouts_per_leaf = std::max(playouts, 1);
+        playout_pool.reset();
+
+        if (threads > 1) {
+            playout_pool = std::make_unique<PlayoutPool>(threads, generator());
+        }
+
+        for (auto& worker : root_workers) {
+            worker->set_leaf_parallel(playouts_per_leaf);
+        }
+    }
+
+    // searches trees independent trees of iters_per_move simulations each on
+    // their own threads and merges the root visits; enable before the first
+    // select_move, 1 keeps a single tree
+    void set_root_parallel(int trees) {
+        root_workers.clear();
+
+        for (int i = 0; trees > 1 and i < trees; ++i) {
+            root_workers.push_back(std::make_unique<MctsAgent>(uct_factor, iters_per_move, generator()));
+            root_workers.back()->set_transpositions(use_transpositions);
+            root_workers.back()->set_leaf_parallel(playouts_per_leaf);
+            root_workers.back()->set_endgame_solver(solver_empties);
+        }
+    }
+
+    // solves positions with at most empties empty squares exactly and backs
+    // proven results up the tree, 0 disables
+    void set_endgame_solver(int empties) {
+        solver_empties = std::max(empties, 0);
+
+        for (auto& worker : root_workers) {
+            worker->set_endgame_solver(solver_empties);
+        }
+    }
+
+    const SearchStats& get_search_stats() const {
+        return stats;
+    }
+
+    size_t get_tree_size() const {
+        return tree.size();
     }
 
     virtual std::pair<move, std::vector<std::pair<move, int>>> select_move(GameState& state) override {
-        for (int i = 0; i < iters_per_move; ++i) {
-            GameState state_copy = root;
-            search_iter(state_copy, root_id);
+        stats = SearchStats();
+        auto start_time = std::chrono::steady_clock::now();
+
+        // proven again below once the root moves are
+        tree[root_id].solved = UNSOLVED;
+
+        if (root_workers.size()) {
+            search_root_parallel(state);
         }
+        else if (num_threads == 1) {
+            for (int i = 0; i < iters_per_move and tree[root_id].solved == UNSOLVED; ++i) {
+                GameState state_copy = root;
+                search_iter(state_copy, root_id);
+                stats.simulations++;
+            }
+        }
+        else {
+            search_parallel();
+        }
+
+        stats.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start_time).count();
 
         int best_move = 0;
         float best_value = -1e9;
-        std::vector <std::pair<move, int>> policy(tree[root_id].children.size());
+        std::vector <std::pair<move, int>> policy(tree[root_id].num_edges);
 
-        for (int ch = 0; ch < tree[root_id].children.size(); ++ch) {
-            auto mv = tree[root_id].children[ch];
+        for (int ch = 0; ch < tree[root_id].num_edges; ++ch) {
+            const Edge& edge = child_edge(root_id, ch);
 
-            if (mv.second != -1) {
-                policy[ch] = {mv.first, tree[mv.second].visits};
-                float ch_value = tree[mv.second].score / (float)tree[mv.second].visits;
+            if (edge.node_id != -1) {
+                policy[ch] = {id_to_move(edge.square), tree[edge.node_id].visits};
+                float ch_value = tree[edge.node_id].score / (float)tree[edge.node_id].visits;
+
+                // proven wins and losses come before any estimate
+                if (tree[edge.node_id].solved != UNSOLVED) {
+                    ch_value = 2 * tree[edge.node_id].solved;
+                }
 
                 if (best_value < ch_value) {
                     best_value = ch_value;
@@ -157,12 +587,12 @@ public:
                 }
             }
             else {
-                policy[ch] = {mv.first, 0};
+                policy[ch] = {id_to_move(edge.square), 0};
             }
         }
 
         return {
-            tree[root_id].children[best_move].first,
+            id_to_move(child_edge(root_id, best_move).square),
             policy
         };
     }
@@ -170,14 +600,26 @@ public:
     virtual void make_move(const move& move) override {
         root.make_move(move);
 
-        for (auto& mv : tree[root_id].children) {
-            if (mv.first == move) {
-                if (mv.second == -1) {
-                    mv.second = tree.size();
-                    tree.emplace_back(root);
+        for (auto& worker : root_workers) {
+            worker->make_move(move);
+        }
+
+        for (int ch = 0; ch < tree[root_id].num_edges; ++ch) {
+            if (child_edge(root_id, ch).square == move_to_id(move)) {
+                if (child_edge(root_id, ch).node_id == -1) {
+                    int node_id = find_transposition(root);
+
+                    if (node_id == -1) {
+                        node_id = add_node(root);  // may reallocate the arenas
+                    }
+
+                    child_edge(root_id, ch).node_id = node_id;
                 }
 
-                root_id = mv.second;
+                root_id = child_edge(root_id, ch).node_id;
+
+                // keep only the subtree under the new root
+                root_id = compact_tree(tree, edges, root_id, transpositions, iters_per_move + 1, 8 * (iters_per_move + 1));
                 return;
             }
         }
@@ -0,0 +1,83 @@
+#ifndef TREE_COMPACTION
+#define TREE_COMPACTION
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Copies the part of the tree reachable from root_id into fresh arenas and
+// drops the rest, so that memory follows the live tree after the root moves.
+// Nodes need first_edge / num_edges, edges need node_id (-1 if unexpanded).
+// The nodes are laid out breadth first from the root, which becomes node 0;
+// the transposition table keeps only the surviving nodes. extra_nodes and
+// extra_edges are reserved on top for the next search.
+template <typename Node, typename Edge>
+int compact_tree(
+    std::vector <Node>& tree,
+    std::vector <Edge>& edges,
+    int root_id,
+    std::unordered_map <uint64_t, int>& transpositions,
+    size_t extra_nodes,
+    size_t extra_edges)
+{
+    std::vector <int> new_id(tree.size(), -1);
+    std::vector <int> order;
+    size_t live_edges = 0;
+
+    new_id[root_id] = 0;
+    order.push_back(root_id);
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Node& node = tree[order[i]];
+        live_edges += node.num_edges;
+
+        for (int ch = 0; ch < node.num_edges; ++ch) {
+            int child = edges[node.first_edge + ch].node_id;
+
+            // a DAG node reached by several parents is copied once
+            if (child != -1 and new_id[child] == -1) {
+                new_id[child] = order.size();
+                order.push_back(child);
+            }
+        }
+    }
+
+    std::vector <Node> new_tree;
+    std::vector <Edge> new_edges;
+    new_tree.reserve(order.size() + extra_nodes);
+    new_edges.reserve(live_edges + extra_edges);
+
+    for (int old_id : order) {
+        Node node = tree[old_id];
+        node.first_edge = new_edges.size();
+
+        for (int ch = 0; ch < node.num_edges; ++ch) {
+            Edge edge = edges[tree[old_id].first_edge + ch];
+
+            if (edge.node_id != -1) {
+                edge.node_id = new_id[edge.node_id];
+            }
+
+            new_edges.push_back(edge);
+        }
+
+        new_tree.push_back(node);
+    }
+
+    for (auto it = transpositions.begin(); it != transpositions.end(); ) {
+        if (new_id[it->second] == -1) {
+            it = transpositions.erase(it);
+        }
+        else {
+            it->second = new_id[it->second];
+            ++it;
+        }
+    }
+
+    tree.swap(new_tree);
+    edges.swap(new_edges);
+
+    return 0;
+}
+
+#endif
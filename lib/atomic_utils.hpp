@@ -0,0 +1,38 @@
+#ifndef ATOMIC_UTILS
+#define ATOMIC_UTILS
+
+// Atomic access to plain fields that are shared between search threads only
+// during a tree-parallel search; outside of it they are used as ordinary
+// values, so the tree arenas stay copyable and compact.
+
+template <typename T>
+T load_atomic(const T& target, int order = __ATOMIC_RELAXED) {
+    T result;
+    __atomic_load(&target, &result, order);
+    return result;
+}
+
+template <typename T>
+void store_atomic(T& target, T value, int order = __ATOMIC_RELAXED) {
+    __atomic_store(&target, &value, order);
+}
+
+template <typename T>
+bool compare_exchange_atomic(T& target, T expected, T desired) {
+    return __atomic_compare_exchange(&target, &expected, &desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+inline void add_atomic(int& target, int delta) {
+    __atomic_fetch_add(&target, delta, __ATOMIC_RELAXED);
+}
+
+inline void add_atomic(float& target, float delta) {
+    float current = load_atomic(target);
+    float desired = current + delta;
+
+    while (not __atomic_compare_exchange(&target, &current, &desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        desired = current + delta;
+    }
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef COLLECT_CONFIG
+#define COLLECT_CONFIG
+
+#include "self_play.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Settings of a collect_dataset run. They are read from "key value" lines of
+// a config file (# starts a comment) or given as --key value on the command
+// line, and saved with every generation so it can be resumed with them.
+struct CollectConfig {
+    int threads = 4;
+    int games = 200;
+    std::string model_path = "models/trained.onnx";
+    std::string datasets_path = "datasets/";
+    int generations_kept = 20;
+
+    // agent seeds of every game derive from it, 0 picks one at random
+    uint32_t seed = 0;
+
+    float puct_factor = 0.3f;
+    int iters_per_move = 800;
+    int batch_size = 8;
+    int concurrent_games = 32;
+    int solver_empties = 10;
+
+    int max_batch = 256;
+    int max_wait_us = 2000;
+    int cache_mb = 1024;  // 0 disables the evaluation cache
+
+    // stores every position in all 8 symmetries, 8 times the disk space and
+    // the share of a generation in the replay window
+    bool augment_symmetries = false;
+
+    // games are on disk, and count as done, once their chunk is written
+    int chunk_samples = 16384;
+
+    int metrics_interval = 30;  // seconds, builds with -DENABLE_INSTRUMENTATION only
+    int trace_events = 1 << 16;  // per thread, 0 disables tracing
+
+    template <typename Config, typename Visitor>
+    static void visit(Config& config, Visitor&& visitor) {
+        visitor("threads", config.threads);
+        visitor("games", config.games);
+        visitor("model", config.model_path);
+        visitor("datasets", config.datasets_path);
+        visitor("generations_kept", config.generations_kept);
+        visitor("seed", config.seed);
+        visitor("puct", config.puct_factor);
+        visitor("iterations", config.iters_per_move);
+        visitor("batch_size", config.batch_size);
+        visitor("concurrent_games", config.concurrent_games);
+        visitor("solver_empties", config.solver_empties);
+        visitor("max_batch", config.max_batch);
+        visitor("max_wait_us", config.max_wait_us);
+        visitor("cache_mb", config.cache_mb);
+        visitor("augment", config.augment_symmetries);
+        visitor("chunk_samples", config.chunk_samples);
+        visitor("metrics_interval", config.metrics_interval);
+        visitor("trace_events", config.trace_events);
+    }
+
+    static void parse_value(const std::string& text, std::string& value) {
+        value = text;
+    }
+
+    static void parse_value(const std::string& text, bool& value) {
+        if (text != "0" and text != "1" and text != "false" and text != "true") {
+            throw std::invalid_argument("expected 0 or 1, got " + text);
+        }
+
+        value = text == "1" or text == "true";
+    }
+
+    template <typename T>
+    static void parse_value(const std::string& text, T& value) {
+        std::istringstream stream(text);
+        char rest;
+
+        if (not (stream >> value) or stream >> rest) {
+            throw std::invalid_argument("not a number: " + text);
+        }
+    }
+
+    // dashes in key are read as underscores
+    void set(std::string key, const std::string& value) {
+        bool found = false;
+
+        for (char& c : key) {
+            if (c == '-') {
+                c = '_';
+            }
+        }
+
+        visit(*this, [&](const char* name, auto& field) {
+            if (key == name) {
+                parse_value(value, field);
+                found = true;
+            }
+        });
+
+        if (not found) {
+            throw std::invalid_argument("unknown option " + key);
+        }
+    }
+
+    void load(const std::string& path) {
+        std::ifstream file(path);
+
+        if (not file) {
+            throw std::runtime_error("Could not read " + path);
+        }
+
+        std::string line;
+
+        while (std::getline(file, line)) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string key, value;
+
+            if (fields >> key) {
+                std::getline(fields >> std::ws, value);
+                value.erase(value.find_last_not_of(" \t\r") + 1);
+                set(key, value);
+            }
+        }
+    }
+
+    // "config" entries name files, they are loaded first so that the other
+    // options take precedence wherever they appear
+    void apply(const std::vector <std::pair <std::string, std::string>>& options) {
+        for (auto& [key, value] : options) {
+            if (key == "config") {
+                load(value);
+            }
+        }
+
+        for (auto& [key, value] : options) {
+            if (key != "config") {
+                set(key, value);
+            }
+        }
+    }
+
+    void write(std::ostream& out) const {
+        visit(*this, [&](const char* name, const auto& field) {
+            out << name << " " << field << "\n";
+        });
+    }
+
+    SelfPlayConfig self_play_config() const {
+        SelfPlayConfig config;
+        config.puct_factor = puct_factor;
+        config.iters_per_move = iters_per_move;
+        config.batch_size = batch_size;
+        config.concurrent_games = concurrent_games;
+        config.solver_empties = solver_empties;
+
+        return config;
+    }
+};
+
+// --key value pairs in order, flags without a value get "1"
+std::vector <std::pair <std::string, std::string>> parse_command_line(int argc, char** argv, const std::vector <std::string>& flags) {
+    std::vector <std::pair <std::string, std::string>> options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--", 0) != 0) {
+            throw std::invalid_argument("unexpected argument " + arg);
+        }
+
+        std::string key = arg.substr(2);
+
+        if (std::find(flags.begin(), flags.end(), key) != flags.end()) {
+            options.emplace_back(key, "1");
+        }
+        else if (i + 1 < argc) {
+            options.emplace_back(key, argv[++i]);
+        }
+        else {
+            throw std::invalid_argument("missing value of " + arg);
+        }
+    }
+
+    return options;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef DATASET
 #define DATASET
 
+#include "tracing.hpp"
 #include "utils.hpp"
 
 #include <vector>
@@ -51,6 +52,7 @@ public:
     }
 
     void dump(std::string path) {
+        TRACE_SCOPE("dataset_dump", samples.size());
         std::ofstream board_dump_file((path + "board.bin").c_str(), std::ios::binary);
         for (auto& sample : samples) {
             board_dump_file.write(reinterpret_cast<char*>(sample.board.data()), sample.board.size() * sizeof(float));
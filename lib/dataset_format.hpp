@@ -0,0 +1,225 @@
+#ifndef DATASET_FORMAT
+#define DATASET_FORMAT
+
+#include "simulation_utils.hpp"
+#include "symmetry.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Dataset chunk files start with this header. Version 1 chunks (16 byte
+// header, no policy_entries) hold dense float32 records of board tensor,
+// policy over 65 moves and value. Version 2 chunks are compact and column
+// wise, see CompactChunk.
+const uint32_t DENSE_CHUNK_VERSION = 1;
+const uint32_t COMPACT_CHUNK_VERSION = 2;
+const int DENSE_SAMPLE_FLOATS = 3 * 64 + 65 + 1;
+const size_t DENSE_HEADER_BYTES = 16;
+
+struct DatasetChunkHeader {
+    char magic[4] = {'A', 'Z', 'D', 'S'};
+    uint32_t version = COMPACT_CHUNK_VERSION;
+    uint32_t samples = 0;
+    uint32_t games = 0;
+    uint32_t policy_entries = 0;
+};
+
+// one training sample expanded to the network tensors
+struct DatasetSample {
+    std::array <float, 3 * 64> board;
+    std::array <float, 65> policy;
+    float value;
+};
+
+// Samples stored as two bitboards, the side to move, an int8 value and the
+// moves with visits as square id plus the visit share quantized to uint16,
+// about 50 bytes per sample instead of 1 KB. Written column by column:
+// white[samples] u64, black[samples] u64, side[samples] u8,
+// value[samples] i8, policy_counts[samples] u8, squares[policy_entries] u8,
+// probabilities[policy_entries] u16, all little endian.
+struct CompactChunk {
+    static constexpr float PROBABILITY_SCALE = 65535.0f;
+
+    std::vector <uint64_t> white;
+    std::vector <uint64_t> black;
+    std::vector <uint8_t> side;
+    std::vector <int8_t> value;
+    std::vector <uint8_t> policy_counts;
+    std::vector <uint8_t> squares;
+    std::vector <uint16_t> probabilities;
+    uint32_t games = 0;
+
+    void reserve(int samples) {
+        white.reserve(samples);
+        black.reserve(samples);
+        side.reserve(samples);
+        value.reserve(samples);
+        policy_counts.reserve(samples);
+        squares.reserve(samples * MoveList::MAX_MOVES);
+        probabilities.reserve(samples * MoveList::MAX_MOVES);
+    }
+
+    uint32_t samples() const {
+        return white.size();
+    }
+
+    void clear() {
+        white.clear();
+        black.clear();
+        side.clear();
+        value.clear();
+        policy_counts.clear();
+        squares.clear();
+        probabilities.clear();
+        games = 0;
+    }
+
+    // stores the sample transformed by one of the board symmetries
+    void add(const GameMove& game_move, int symmetry = 0) {
+        uint64_t white_stones = 0, black_stones = 0;
+
+        for (int id = 0; id < 64; ++id) {
+            white_stones |= (uint64_t)(game_move.board[id] > 0.5f) << id;
+            black_stones |= (uint64_t)(game_move.board[64 + id] > 0.5f) << id;
+        }
+
+        white.push_back(transform_bitboard(white_stones, symmetry));
+        black.push_back(transform_bitboard(black_stones, symmetry));
+        side.push_back(game_move.board[128] > 0.5f ? 2 : 1);
+        value.push_back(game_move.value);
+
+        int sum = 0;
+
+        for (auto& mv : game_move.policy) {
+            sum += mv.second;
+        }
+
+        // without visits, e.g. at a root proven before it was searched, the
+        // moves share the policy evenly
+        bool uniform = sum == 0;
+        uint8_t count = 0;
+
+        for (auto& mv : game_move.policy) {
+            if (mv.second or uniform) {
+                float share = uniform ? 1.0f / game_move.policy.size() : mv.second / (float)sum;
+                squares.push_back(transform_square(move_to_id(mv.first), symmetry));
+                probabilities.push_back(std::lround(share * PROBABILITY_SCALE));
+                count++;
+            }
+        }
+
+        policy_counts.push_back(count);
+    }
+
+    template <typename T>
+    static void write_column(std::ofstream& file, const std::vector <T>& column) {
+        file.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(T));
+    }
+
+    template <typename T>
+    static void read_column(std::ifstream& file, std::vector <T>& column, size_t size) {
+        column.resize(size);
+        file.read(reinterpret_cast<char*>(column.data()), size * sizeof(T));
+    }
+
+    void write(std::ofstream& file) const {
+        DatasetChunkHeader header;
+        header.samples = samples();
+        header.games = games;
+        header.policy_entries = squares.size();
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_column(file, white);
+        write_column(file, black);
+        write_column(file, side);
+        write_column(file, value);
+        write_column(file, policy_counts);
+        write_column(file, squares);
+        write_column(file, probabilities);
+    }
+
+    void read(std::ifstream& file, const DatasetChunkHeader& header) {
+        read_column(file, white, header.samples);
+        read_column(file, black, header.samples);
+        read_column(file, side, header.samples);
+        read_column(file, value, header.samples);
+        read_column(file, policy_counts, header.samples);
+        read_column(file, squares, header.policy_entries);
+        read_column(file, probabilities, header.policy_entries);
+        games = header.games;
+    }
+
+    // writes the samples expanded to tensors into out
+    void expand(std::vector <DatasetSample>& out) const {
+        size_t entry = 0;
+
+        for (size_t i = 0; i < white.size(); ++i) {
+            DatasetSample sample{};
+
+            for (int id = 0; id < 64; ++id) {
+                sample.board[id] = (white[i] >> id) & 1;
+                sample.board[64 + id] = (black[i] >> id) & 1;
+                sample.board[128 + id] = (side[i] == 2);
+            }
+
+            for (int k = 0; k < policy_counts[i]; ++k, ++entry) {
+                sample.policy[squares[entry]] = probabilities[entry] / PROBABILITY_SCALE;
+            }
+
+            sample.value = value[i];
+            out.push_back(sample);
+        }
+    }
+};
+
+// reads a chunk of either version with its samples expanded to tensors
+std::vector <DatasetSample> read_dataset_chunk(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    DatasetChunkHeader header;
+    file.read(reinterpret_cast<char*>(&header), DENSE_HEADER_BYTES);
+
+    if (not file or std::string(header.magic, 4) != "AZDS") {
+        throw std::runtime_error(path + " is not a dataset chunk");
+    }
+
+    std::vector <DatasetSample> samples;
+
+    if (header.version == DENSE_CHUNK_VERSION) {
+        std::vector <float> record(DENSE_SAMPLE_FLOATS);
+
+        for (uint32_t i = 0; i < header.samples; ++i) {
+            file.read(reinterpret_cast<char*>(record.data()), record.size() * sizeof(float));
+
+            DatasetSample sample;
+            std::copy(record.begin(), record.begin() + 3 * 64, sample.board.begin());
+            std::copy(record.begin() + 3 * 64, record.end() - 1, sample.policy.begin());
+            sample.value = record.back();
+            samples.push_back(sample);
+        }
+    }
+    else if (header.version == COMPACT_CHUNK_VERSION) {
+        file.read(reinterpret_cast<char*>(&header.policy_entries), sizeof(header.policy_entries));
+
+        CompactChunk chunk;
+        chunk.read(file, header);
+        chunk.expand(samples);
+    }
+    else {
+        throw std::runtime_error(path + " has unknown dataset version " + std::to_string(header.version));
+    }
+
+    if (not file) {
+        throw std::runtime_error(path + " is truncated");
+    }
+
+    return samples;
+}
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef DATASET_WRITER
+#define DATASET_WRITER
+
+#include "dataset_format.hpp"
+#include "instrumentation.hpp"
+#include "simulation_utils.hpp"
+#include "tracing.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Appends finished games to numbered compact chunk files (see CompactChunk)
+// in a directory while they are played. Games are collected in one buffer
+// while a background thread writes the other, so memory stays at two chunks
+// however long the run is.
+// A chunk is written under a temporary name and renamed when complete, a
+// crash loses at most the chunks in memory. Complete chunks are listed in
+// index.txt of the directory, one "file version samples games" line each,
+// so readers can address samples without opening every chunk. With
+// augmentation every position is stored in all 8 board symmetries. add_game
+// is thread safe.
+// Games added with an id have it listed in chunk_NNNNNN.games next to their
+// chunk; a chunk counts as written once it is in the index, so after a crash
+// recover() tells which games are on disk and removes partial chunks.
+class DatasetWriter {
+private:
+    using Chunk = CompactChunk;
+
+    std::string directory;
+    uint32_t samples_per_chunk;
+    bool augment_symmetries = false;
+    int next_chunk_id;
+
+    std::mutex mutex;
+    std::condition_variable writer_cv;  // a chunk is ready to be written
+    std::condition_variable done_cv;    // the writer is idle again
+    Chunk buffers[2];
+    std::vector <int> buffer_game_ids[2];
+    Chunk* filling = &buffers[0];
+    Chunk* writing = nullptr;  // handed to the writer thread
+    bool stopping = false;
+    std::string error;
+    std::thread writer_thread;
+
+    std::string chunk_path(int chunk_id) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "chunk_%06d.bin", chunk_id);
+
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    static std::string game_ids_path(const std::string& chunk_path) {
+        return std::filesystem::path(chunk_path).replace_extension(".games").string();
+    }
+
+    std::vector <int>& game_ids_of(const Chunk* chunk) {
+        return buffer_game_ids[chunk - buffers];
+    }
+
+    void write_chunk(const Chunk& chunk, const std::vector <int>& game_ids, int chunk_id) {
+        TRACE_SCOPE("write_chunk", chunk.samples());
+        std::string path = chunk_path(chunk_id);
+        std::string temp_path = path + ".tmp";
+
+        if (not game_ids.empty()) {
+            std::ofstream ids_file(game_ids_path(path));
+
+            for (int game_id : game_ids) {
+                ids_file << game_id << "\n";
+            }
+
+            ids_file.close();
+
+            if (not ids_file) {
+                throw std::runtime_error("Could not write the game ids of " + path);
+            }
+        }
+
+        std::ofstream file(temp_path, std::ios::binary);
+        chunk.write(file);
+        file.close();
+
+        if (not file) {
+            throw std::runtime_error("Could not write dataset chunk " + temp_path);
+        }
+
+        std::filesystem::rename(temp_path, path);
+
+        std::ofstream index((std::filesystem::path(directory) / "index.txt").string(), std::ios::app);
+        index << std::filesystem::path(path).filename().string() << " "
+              << COMPACT_CHUNK_VERSION << " "
+              << chunk.samples() << " "
+              << chunk.games << std::endl;
+
+        if (not index) {
+            throw std::runtime_error("Could not update the index of " + directory);
+        }
+    }
+
+    void writer_loop() {
+        set_trace_thread_name("dataset writer");
+        std::unique_lock <std::mutex> lock(mutex);
+
+        while (true) {
+            writer_cv.wait(lock, [this] { return stopping or writing; });
+
+            if (not writing) {
+                return;
+            }
+
+            int chunk_id = next_chunk_id++;
+            lock.unlock();
+
+            try {
+                PROFILE_SCOPE(dataset_write);
+                write_chunk(*writing, game_ids_of(writing), chunk_id);
+            }
+            catch (const std::exception& e) {
+                lock.lock();
+                error = e.what();
+                lock.unlock();
+            }
+
+            writing->clear();
+            game_ids_of(writing).clear();
+
+            lock.lock();
+            writing = nullptr;
+            done_cv.notify_all();
+        }
+    }
+
+    // hands the filled buffer to the writer, waiting for it to finish the previous one
+    void swap_buffers(std::unique_lock <std::mutex>& lock) {
+        done_cv.wait(lock, [this] { return writing == nullptr; });
+
+        if (not filling->samples()) {
+            return;
+        }
+
+        writing = filling;
+        filling = (filling == &buffers[0] ? &buffers[1] : &buffers[0]);
+        writer_cv.notify_one();
+        done_cv.notify_all();
+    }
+
+    void check_error() {
+        if (not error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+
+public:
+    // continues after the chunks already in the directory
+    DatasetWriter(const std::string& directory, int samples_per_chunk = 65536)
+        : directory(directory),
+          samples_per_chunk(samples_per_chunk),
+          next_chunk_id(0)
+    {
+        std::filesystem::create_directories(directory);
+
+        while (std::filesystem::exists(chunk_path(next_chunk_id))) {
+            next_chunk_id++;
+        }
+
+        for (auto& buffer : buffers) {
+            buffer.reserve(samples_per_chunk + 128);
+        }
+
+        writer_thread = std::thread(&DatasetWriter::writer_loop, this);
+    }
+
+    // stores every position in all 8 board symmetries
+    void set_augment_symmetries(bool enabled) {
+        std::lock_guard <std::mutex> lock(mutex);
+        augment_symmetries = enabled;
+    }
+
+    // a game is never split between two chunks; game_id, if not negative,
+    // is recorded with the chunk
+    void add_game(const GameHistory& game_history, int game_id = -1) {
+        TRACE_SCOPE("add_game", game_history.history.size());
+        std::unique_lock <std::mutex> lock(mutex, std::defer_lock);
+
+        {
+            PROFILE_SCOPE(dataset_wait);
+            lock.lock();
+            check_error();
+
+            // a full buffer is being handed over by the thread that filled it
+            done_cv.wait(lock, [this] { return filling->samples() < samples_per_chunk; });
+        }
+
+        int symmetries = augment_symmetries ? NUM_SYMMETRIES : 1;
+
+        for (auto& game_move : game_history.history) {
+            for (int symmetry = 0; symmetry < symmetries; ++symmetry) {
+                filling->add(game_move, symmetry);
+            }
+        }
+
+        filling->games++;
+
+        if (game_id >= 0) {
+            game_ids_of(filling).push_back(game_id);
+        }
+
+        if (filling->samples() >= samples_per_chunk) {
+            PROFILE_SCOPE(dataset_wait);
+            swap_buffers(lock);
+        }
+    }
+
+    // Ids of the games in the indexed chunks of directory. Chunks missing
+    // from the index, their id lists, temporary files and a torn last index
+    // line are left over by a crash and removed, their games were lost.
+    static std::vector <int> recover(const std::string& directory) {
+        std::vector <int> game_ids;
+        std::filesystem::path root(directory);
+
+        if (not std::filesystem::exists(root)) {
+            return game_ids;
+        }
+
+        std::vector <std::string> index_lines;
+        std::vector <std::string> indexed;
+        bool torn = false;
+        std::ifstream index((root / "index.txt").string());
+        std::string line;
+
+        while (std::getline(index, line)) {
+            std::istringstream fields(line);
+            std::string name;
+            int version, samples, games;
+
+            if (not (fields >> name >> version >> samples >> games) or not std::filesystem::exists(root / name)) {
+                torn = true;
+                break;
+            }
+
+            index_lines.push_back(line);
+            indexed.push_back(name);
+        }
+
+        index.close();
+
+        if (torn) {
+            std::string temp_path = (root / "index.txt.tmp").string();
+            std::ofstream rewritten(temp_path);
+
+            for (auto& index_line : index_lines) {
+                rewritten << index_line << "\n";
+            }
+
+            rewritten.close();
+            std::filesystem::rename(temp_path, root / "index.txt");
+        }
+
+        std::vector <std::filesystem::path> leftovers;
+
+        for (auto& entry : std::filesystem::directory_iterator(root)) {
+            std::string name = entry.path().filename().string();
+            std::string chunk_name = entry.path().stem().string() + ".bin";
+            std::string extension = entry.path().extension().string();
+            bool is_indexed = std::find(indexed.begin(), indexed.end(), chunk_name) != indexed.end();
+
+            if (extension == ".tmp" or (name.rfind("chunk_", 0) == 0 and (extension == ".bin" or extension == ".games") and not is_indexed)) {
+                leftovers.push_back(entry.path());
+            }
+        }
+
+        for (auto& path : leftovers) {
+            std::filesystem::remove(path);
+        }
+
+        for (auto& name : indexed) {
+            std::ifstream ids_file(game_ids_path((root / name).string()));
+            int game_id;
+
+            while (ids_file >> game_id) {
+                game_ids.push_back(game_id);
+            }
+        }
+
+        std::sort(game_ids.begin(), game_ids.end());
+        return game_ids;
+    }
+
+    // writes out the games collected so far and waits until they are on disk
+    void flush() {
+        std::unique_lock <std::mutex> lock(mutex);
+        swap_buffers(lock);
+        done_cv.wait(lock, [this] { return writing == nullptr; });
+        check_error();
+    }
+
+    ~DatasetWriter() {
+        try {
+            flush();
+        }
+        catch (const std::exception&) {
+            // write errors are reported by an explicit flush()
+        }
+
+        {
+            std::lock_guard <std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        writer_cv.notify_one();
+        writer_thread.join();
+    }
+
+    DatasetWriter(const DatasetWriter&) = delete;
+    DatasetWriter& operator=(const DatasetWriter&) = delete;
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef ENDGAME_SOLVER
+#define ENDGAME_SOLVER
+
+#include "othello.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Exact negamax alpha-beta search of the final disc difference. Positions
+// are stored from the view of the player to move. Moves are ordered by the
+// mobility they leave to the opponent (corners and odd regions first), near
+// the end only by region parity. Bounds of positions with enough empty
+// squares are kept in a transposition table.
+class EndgameSolver {
+private:
+    struct Entry {
+        uint64_t own;
+        uint64_t enemy;
+        int8_t lower;
+        int8_t upper;
+    };
+
+    static constexpr int TABLE_BITS = 18;
+    static constexpr int TABLE_MIN_EMPTIES = 7;     // smaller positions are not stored
+    static constexpr int ORDERING_MIN_EMPTIES = 6;  // below only parity ordering
+    static constexpr uint64_t CORNERS = 0x8100000000000081ULL;
+    static constexpr uint64_t QUADRANTS[4] = {
+        0x000000000f0f0f0fULL,
+        0x00000000f0f0f0f0ULL,
+        0x0f0f0f0f00000000ULL,
+        0xf0f0f0f000000000ULL
+    };
+
+    std::vector <Entry> table;  // allocated on first use
+    uint64_t nodes = 0;
+
+    static uint64_t odd_regions(const uint64_t empty) {
+        uint64_t result = 0;
+
+        for (uint64_t quadrant : QUADRANTS) {
+            if (__builtin_popcountll(empty & quadrant) & 1) {
+                result |= quadrant;
+            }
+        }
+
+        return result;
+    }
+
+    Entry& entry_of(const uint64_t own, const uint64_t enemy) {
+        uint64_t key = own * 0x9e3779b97f4a7c15ULL ^ (enemy + 0x632be59bd9b4e019ULL) * 0xbf58476d1ce4e5b9ULL;
+        return table[key >> (64 - TABLE_BITS)];
+    }
+
+    int negamax(const uint64_t own, const uint64_t enemy, int alpha, int beta, const bool passed) {
+        nodes++;
+
+        const uint64_t moves = GameState::generate_moves(own, enemy);
+
+        if (not moves) {
+            if (passed) {
+                return __builtin_popcountll(own) - __builtin_popcountll(enemy);
+            }
+
+            return -negamax(enemy, own, -beta, -alpha, true);
+        }
+
+        const uint64_t empty = ~(own | enemy);
+        const int empties = __builtin_popcountll(empty);
+        Entry* entry = nullptr;
+
+        if (empties >= TABLE_MIN_EMPTIES) {
+            entry = &entry_of(own, enemy);
+
+            if (entry->own == own and entry->enemy == enemy) {
+                if (entry->lower >= beta) {
+                    return entry->lower;
+                }
+
+                if (entry->upper <= alpha) {
+                    return entry->upper;
+                }
+
+                alpha = std::max(alpha, (int)entry->lower);
+                beta = std::min(beta, (int)entry->upper);
+            }
+        }
+
+        const int alpha_start = alpha;
+
+        const uint64_t odd = odd_regions(empty);
+        int best = -65;
+
+        auto try_move = [&](const uint64_t placed) {
+            const uint64_t flips = GameState::generate_flips(placed, own, enemy);
+            const int value = -negamax(enemy & ~flips, own | placed | flips, -beta, -std::max(alpha, best), false);
+            best = std::max(best, value);
+        };
+
+        if (empties >= ORDERING_MIN_EMPTIES) {
+            std::pair <int, uint64_t> ordered[MoveList::MAX_MOVES];
+            int count = 0;
+
+            for (uint64_t rest = moves; rest; rest &= rest - 1) {
+                const uint64_t placed = rest & (0 - rest);
+                const uint64_t flips = GameState::generate_flips(placed, own, enemy);
+                const uint64_t mobility = GameState::generate_moves(enemy & ~flips, own | placed | flips);
+
+                int key = 4 * __builtin_popcountll(mobility);
+                key -= (placed & CORNERS) ? 8 : 0;
+                key -= (placed & odd) ? 2 : 0;
+
+                ordered[count++] = {key, placed};
+            }
+
+            std::sort(ordered, ordered + count, [](const auto& a, const auto& b) {
+                return a.first < b.first;
+            });
+
+            for (int i = 0; i < count and best < beta; ++i) {
+                try_move(ordered[i].second);
+            }
+        }
+        else {
+            // moves into regions with an odd number of empty squares first
+            for (uint64_t rest = moves & odd; rest and best < beta; rest &= rest - 1) {
+                try_move(rest & (0 - rest));
+            }
+
+            for (uint64_t rest = moves & ~odd; rest and best < beta; rest &= rest - 1) {
+                try_move(rest & (0 - rest));
+            }
+        }
+
+        if (entry) {
+            if (entry->own != own or entry->enemy != enemy) {
+                *entry = Entry{own, enemy, -64, 64};
+            }
+
+            if (best > alpha_start) {
+                entry->lower = std::max((int)entry->lower, best);
+            }
+
+            if (best < beta) {
+                entry->upper = std::min((int)entry->upper, best);
+            }
+        }
+
+        return best;
+    }
+
+public:
+    // final disc difference for the player to move under perfect play
+    int solve_exact(const GameState& state) {
+        table.resize(1 << TABLE_BITS);
+        return negamax(state.stones_of(state.current_player), state.stones_of(state.current_player ^ 3), -65, 65, false);
+    }
+
+    // 1 win, 0 draw, -1 loss for the player to move; a null window search is
+    // much cheaper than the exact difference
+    int solve_result(const GameState& state) {
+        table.resize(1 << TABLE_BITS);
+        int value = negamax(state.stones_of(state.current_player), state.stones_of(state.current_player ^ 3), -1, 1, false);
+
+        return (value > 0) - (value < 0);
+    }
+
+    uint64_t get_nodes() const {
+        return nodes;
+    }
+};
+
+int count_empties(const GameState& state) {
+    return 64 - __builtin_popcountll(state.white_stones | state.black_stones);
+}
+
+// one solver per thread, its table is shared by all agents searching there
+EndgameSolver& thread_endgame_solver() {
+    thread_local EndgameSolver solver;
+    return solver;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef EVAL_CACHE
+#define EVAL_CACHE
+
+#include "instrumentation.hpp"
+#include "othello.hpp"
+#include "symmetry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Model evaluations (value and 65 move priors) of positions, shared by
+// agents and threads. Positions are stored in their canonical form, so the
+// 8 symmetric variants of a position share one entry. The cache is split
+// into shards with their own lock and least recently used eviction; the
+// memory budget covers the entries and their index.
+class EvalCache {
+private:
+    struct Entry {
+        uint64_t key;
+        int prev;  // towards the most recently used entry
+        int next;
+        float value;
+        std::array <float, 65> policy;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::vector <Entry> entries;
+        std::unordered_map <uint64_t, int> index;
+        int head = -1;  // most recently used
+        int tail = -1;  // evicted next
+    };
+
+    // index node and bucket of an entry, roughly
+    static constexpr size_t ENTRY_BYTES = sizeof(Entry) + 48;
+
+    std::vector <Shard> shards;
+    size_t entries_per_shard;
+
+    std::atomic <long long> hits{0};
+    std::atomic <long long> misses{0};
+    std::atomic <long long> evictions{0};
+
+    Shard& shard_of(uint64_t key) {
+        return shards[key % shards.size()];
+    }
+
+    static void unlink(Shard& shard, int id) {
+        Entry& entry = shard.entries[id];
+        (entry.prev == -1 ? shard.head : shard.entries[entry.prev].next) = entry.next;
+        (entry.next == -1 ? shard.tail : shard.entries[entry.next].prev) = entry.prev;
+    }
+
+    static void push_front(Shard& shard, int id) {
+        Entry& entry = shard.entries[id];
+        entry.prev = -1;
+        entry.next = shard.head;
+        (shard.head == -1 ? shard.tail : shard.entries[shard.head].prev) = id;
+        shard.head = id;
+    }
+
+public:
+    EvalCache(size_t budget_bytes, int num_shards = 64)
+        : shards(std::max(num_shards, 1)),
+          entries_per_shard(std::max<size_t>(budget_bytes / ENTRY_BYTES / shards.size(), 1)) {}
+
+    // on a hit writes the value and the priors for the squares of state
+    bool lookup(const GameState& state, float& value, float* policy) {
+        int symmetry = canonical_symmetry(state);
+        uint64_t key = canonical_hash(state, symmetry);
+        Shard& shard = shard_of(key);
+
+        std::lock_guard <std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+
+        if (it == shard.index.end()) {
+            misses++;
+            PROFILE_COUNT(cache_misses, 1);
+            return false;
+        }
+
+        unlink(shard, it->second);
+        push_front(shard, it->second);
+
+        const Entry& entry = shard.entries[it->second];
+        value = entry.value;
+        transform_policy(entry.policy.data(), policy, inverse_symmetry(symmetry));
+        hits++;
+        PROFILE_COUNT(cache_hits, 1);
+
+        return true;
+    }
+
+    void insert(const GameState& state, float value, const float* policy) {
+        int symmetry = canonical_symmetry(state);
+        uint64_t key = canonical_hash(state, symmetry);
+        Shard& shard = shard_of(key);
+
+        std::lock_guard <std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        int id;
+
+        if (it != shard.index.end()) {
+            id = it->second;
+            unlink(shard, id);
+        }
+        else if (shard.entries.size() < entries_per_shard) {
+            id = shard.entries.size();
+            shard.entries.emplace_back();
+            shard.index.emplace(key, id);
+        }
+        else {
+            // reuse the least recently used entry
+            id = shard.tail;
+            unlink(shard, id);
+            shard.index.erase(shard.entries[id].key);
+            shard.index.emplace(key, id);
+            evictions++;
+        }
+
+        Entry& entry = shard.entries[id];
+        entry.key = key;
+        entry.value = value;
+        transform_policy(policy, entry.policy.data(), symmetry);
+        push_front(shard, id);
+    }
+
+    void clear() {
+        for (auto& shard : shards) {
+            std::lock_guard <std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
+            shard.head = shard.tail = -1;
+        }
+    }
+
+    long long get_hits() const {
+        return hits;
+    }
+
+    long long get_misses() const {
+        return misses;
+    }
+
+    long long get_evictions() const {
+        return evictions;
+    }
+
+    float hit_rate() const {
+        long long lookups = hits + misses;
+        return lookups ? hits / (float)lookups : 0.0f;
+    }
+
+    size_t capacity() const {
+        return entries_per_shard * shards.size();
+    }
+
+    EvalCache(const EvalCache&) = delete;
+    EvalCache& operator=(const EvalCache&) = delete;
+};
+
+// The cache of a model file, created with budget_bytes by the first caller
+// and shared by all agents of the process that evaluate with the same model.
+// It is released with the last reference.
+std::shared_ptr <EvalCache> shared_eval_cache(const std::string& model_path, size_t budget_bytes) {
+    static std::mutex registry_mutex;
+    static std::unordered_map <std::string, std::weak_ptr <EvalCache>> registry;
+
+    std::lock_guard <std::mutex> lock(registry_mutex);
+    std::shared_ptr <EvalCache> cache = registry[model_path].lock();
+
+    if (not cache) {
+        cache = std::make_shared<EvalCache>(budget_bytes);
+        registry[model_path] = cache;
+    }
+
+    return cache;
+}
+
+#endif
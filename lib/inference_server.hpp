@@ -0,0 +1,212 @@
+#ifndef INFERENCE_SERVER
+#define INFERENCE_SERVER
+
+#include "instrumentation.hpp"
+#include "model_base.hpp"
+#include "onnx_model.hpp"
+#include "tracing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Owns a single model session and evaluates positions submitted by many
+// threads. Requests are collected into one batch until it holds max_batch
+// positions or the oldest request has waited max_wait.
+class InferenceServer {
+private:
+    struct Request {
+        const float* board_tensors;
+        int count;
+        float* values;
+        float* policies;
+        std::promise <void> done;
+    };
+
+    OnnxModel model;
+    int max_batch;
+    std::chrono::microseconds max_wait;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::deque <Request> queue;
+    int queued_positions = 0;
+    bool stopping = false;
+
+    // owned by the server thread; requests are copied straight into the
+    // buffers bound to the session and the results read from there
+    std::vector <Request> batch;
+    std::unique_ptr <OnnxModel::BoundBatch> bound_batch;
+
+    std::atomic <long long> total_batches{0};
+    std::atomic <long long> total_positions{0};
+
+    std::thread worker;
+
+    void take_batch() {
+        batch.clear();
+        int positions = 0;
+
+        // a request is never split, but the first one is always taken
+        while (queue.size() and (positions == 0 or positions + queue.front().count <= max_batch)) {
+            positions += queue.front().count;
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+
+        queued_positions -= positions;
+    }
+
+    void evaluate_batch() {
+        int positions = 0;
+        for (auto& request : batch) {
+            positions += request.count;
+        }
+
+        // only a single request larger than max_batch does not fit
+        if (positions > bound_batch->get_capacity()) {
+            bound_batch = model.make_bound_batch(positions);
+        }
+
+        int offset = 0;
+        for (auto& request : batch) {
+            std::memcpy(bound_batch->input(offset), request.board_tensors, request.count * 3 * 64 * sizeof(float));
+            offset += request.count;
+        }
+
+        try {
+            PROFILE_SCOPE(inference);
+            bound_batch->run(positions);
+        }
+        catch (...) {
+            for (auto& request : batch) {
+                request.done.set_exception(std::current_exception());
+            }
+            return;
+        }
+
+        offset = 0;
+        for (auto& request : batch) {
+            for (int i = 0; i < request.count; ++i) {
+                request.values[i] = bound_batch->value(offset + i);
+            }
+
+            std::memcpy(request.policies, bound_batch->policy(offset), request.count * 65 * sizeof(float));
+            offset += request.count;
+
+            request.done.set_value();
+        }
+
+        total_batches++;
+        total_positions += positions;
+        PROFILE_COUNT(inference_batches, 1);
+        PROFILE_COUNT(inference_positions, positions);
+    }
+
+    void serve() {
+        set_trace_thread_name("inference server");
+
+        while (true) {
+            std::unique_lock <std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return stopping or queue.size(); });
+
+            if (queue.empty()) {
+                return;  // stopping and nothing left to evaluate
+            }
+
+            // give other threads a chance to fill the batch
+            auto deadline = std::chrono::steady_clock::now() + max_wait;
+            queue_cv.wait_until(lock, deadline, [this] { return stopping or queued_positions >= max_batch; });
+
+            take_batch();
+            lock.unlock();
+
+            evaluate_batch();
+        }
+    }
+
+public:
+    InferenceServer(std::string model_path, int max_batch, std::chrono::microseconds max_wait, const ModelConfig& config = ModelConfig())
+        : model(model_path, config),
+          max_batch(std::max(max_batch, 1)),
+          max_wait(max_wait),
+          bound_batch(model.make_bound_batch(this->max_batch)) {
+        worker = std::thread(&InferenceServer::serve, this);
+    }
+
+    // board_tensors, values and policies have to stay valid until the future is ready
+    std::future <void> submit(const float* board_tensors, int count, float* values, float* policies) {
+        std::promise <void> done;
+        std::future <void> result = done.get_future();
+
+        {
+            std::lock_guard <std::mutex> lock(queue_mutex);
+            queue.push_back(Request{board_tensors, count, values, policies, std::move(done)});
+            queued_positions += count;
+        }
+
+        queue_cv.notify_one();
+        return result;
+    }
+
+    // average number of positions per session run
+    float batch_occupancy() const {
+        long long batches = total_batches;
+        return batches ? total_positions / (float)batches : 0.0f;
+    }
+
+    long long get_total_batches() const {
+        return total_batches;
+    }
+
+    long long get_total_positions() const {
+        return total_positions;
+    }
+
+    ~InferenceServer() {
+        {
+            std::lock_guard <std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+
+        queue_cv.notify_one();
+        worker.join();
+    }
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+};
+
+// ModelBase view of an InferenceServer, calls block until the result is ready
+class InferenceClient : public ModelBase {
+private:
+    InferenceServer& server;
+
+public:
+    InferenceClient(InferenceServer& server) : server(server) {}
+
+    std::pair<float, std::array <float, 65>> run_inference(const float* board_tensor) override {
+        std::pair<float, std::array <float, 65>> result;
+        TRACE_SCOPE("wait_inference", 1);
+        server.submit(board_tensor, 1, &result.first, result.second.data()).get();
+
+        return result;
+    }
+
+    void run_batch_inference(const float* board_tensors, int batch_size, float* values, float* policies) override {
+        TRACE_SCOPE("wait_inference", batch_size);
+        server.submit(board_tensors, batch_size, values, policies).get();
+    }
+};
+
+#endif
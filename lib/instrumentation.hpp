@@ -0,0 +1,315 @@
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+// Per thread phase timers and event counters of self-play. Compiled in with
+// -DENABLE_INSTRUMENTATION, otherwise the PROFILE_ macros expand to nothing;
+// when compiled in they can still be switched off at runtime. Every thread
+// writes only its own block of relaxed atomics, readers sum the blocks, so
+// neither side takes a lock.
+
+// phases nest: selection, encoding, inference and backup happen inside search
+enum class Phase : int {
+    search,          // AlphaZeroAgent::select_move, resumable searches only time their steps
+    selection,       // descents to new leaves, batched search only
+    encoding,        // board tensors of new leaves
+    inference,       // model runs, on the server thread in self-play
+    backup,          // expansion and backup of evaluated leaves
+    advance_root,    // AlphaZeroAgent::make_move with tree compaction
+    inference_wait,  // self-play threads with every game waiting for results
+    dataset_wait,    // DatasetWriter::add_game waiting for its lock or a buffer
+    dataset_write,   // chunk files written by the writer thread
+    output_lock,     // waiting for the stdout lock
+    COUNT
+};
+
+enum class Counter : int {
+    simulations,
+    expansions,
+    inferences,
+    evaluations_saved,  // transpositions, symmetric positions and cache hits
+    solved,
+    tree_nodes_max,
+    leaf_batches,       // batches of leaves prepared by the agents
+    leaf_batch_positions,
+    inference_batches,  // session runs of the inference server
+    inference_positions,
+    cache_hits,
+    cache_misses,
+    games,
+    COUNT
+};
+
+const char* PHASE_NAMES[(int)Phase::COUNT] = {
+    "search", "selection", "encoding", "inference", "backup", "advance_root",
+    "inference_wait", "dataset_wait", "dataset_write", "output_lock"
+};
+
+const char* COUNTER_NAMES[(int)Counter::COUNT] = {
+    "simulations", "expansions", "inferences", "evaluations_saved", "solved",
+    "tree_nodes_max", "leaf_batches", "leaf_batch_positions", "inference_batches",
+    "inference_positions", "cache_hits", "cache_misses", "games"
+};
+
+#ifdef ENABLE_INSTRUMENTATION
+const bool INSTRUMENTATION_COMPILED = true;
+#else
+const bool INSTRUMENTATION_COMPILED = false;
+#endif
+
+struct ThreadMetrics {
+    std::atomic <uint64_t> phase_nanoseconds[(int)Phase::COUNT] = {};
+    std::atomic <uint64_t> phase_calls[(int)Phase::COUNT] = {};
+    std::atomic <uint64_t> counters[(int)Counter::COUNT] = {};
+};
+
+// plain sums over all threads
+struct MetricsSnapshot {
+    std::array <uint64_t, (int)Phase::COUNT> phase_nanoseconds{};
+    std::array <uint64_t, (int)Phase::COUNT> phase_calls{};
+    std::array <uint64_t, (int)Counter::COUNT> counters{};
+};
+
+std::atomic <bool>& instrumentation_enabled() {
+    static std::atomic <bool> enabled{true};
+    return enabled;
+}
+
+void set_instrumentation(bool enabled) {
+    instrumentation_enabled().store(enabled, std::memory_order_relaxed);
+}
+
+// blocks are never freed, counts of finished threads stay in the totals;
+// threads beyond MAX_THREADS share the last block
+const int MAX_METRICS_THREADS = 1024;
+
+std::array <ThreadMetrics, MAX_METRICS_THREADS>& metrics_blocks() {
+    static std::array <ThreadMetrics, MAX_METRICS_THREADS> blocks;
+    return blocks;
+}
+
+std::atomic <int>& metrics_threads() {
+    static std::atomic <int> threads{0};
+    return threads;
+}
+
+ThreadMetrics& thread_metrics() {
+    thread_local ThreadMetrics* metrics = &metrics_blocks()[std::min(metrics_threads().fetch_add(1), MAX_METRICS_THREADS - 1)];
+    return *metrics;
+}
+
+void count_event(Counter counter, uint64_t amount) {
+    if (instrumentation_enabled().load(std::memory_order_relaxed)) {
+        thread_metrics().counters[(int)counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+}
+
+void record_max(Counter counter, uint64_t value) {
+    if (instrumentation_enabled().load(std::memory_order_relaxed)) {
+        auto& target = thread_metrics().counters[(int)counter];
+        uint64_t current = target.load(std::memory_order_relaxed);
+
+        while (current < value and not target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+}
+
+class ScopedPhaseTimer {
+private:
+    Phase phase;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    ScopedPhaseTimer(Phase phase)
+        : phase(phase),
+          active(instrumentation_enabled().load(std::memory_order_relaxed)) {
+        if (active) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ScopedPhaseTimer() {
+        if (active) {
+            auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            ThreadMetrics& metrics = thread_metrics();
+            metrics.phase_nanoseconds[(int)phase].fetch_add(nanoseconds, std::memory_order_relaxed);
+            metrics.phase_calls[(int)phase].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_INSTRUMENTATION
+#define PROFILE_SCOPE(phase) ScopedPhaseTimer PROFILE_CONCAT(profile_scope_, __LINE__)(Phase::phase)
+#define PROFILE_COUNT(counter, amount) count_event(Counter::counter, amount)
+#define PROFILE_MAX(counter, value) record_max(Counter::counter, value)
+#else
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_MAX(counter, value) ((void)0)
+#endif
+
+MetricsSnapshot collect_metrics() {
+    MetricsSnapshot snapshot;
+    int threads = std::min(metrics_threads().load(), MAX_METRICS_THREADS);
+
+    for (int t = 0; t < threads; ++t) {
+        const ThreadMetrics& metrics = metrics_blocks()[t];
+
+        for (int p = 0; p < (int)Phase::COUNT; ++p) {
+            snapshot.phase_nanoseconds[p] += metrics.phase_nanoseconds[p].load(std::memory_order_relaxed);
+            snapshot.phase_calls[p] += metrics.phase_calls[p].load(std::memory_order_relaxed);
+        }
+
+        for (int c = 0; c < (int)Counter::COUNT; ++c) {
+            uint64_t value = metrics.counters[c].load(std::memory_order_relaxed);
+
+            if (c == (int)Counter::tree_nodes_max) {
+                snapshot.counters[c] = std::max(snapshot.counters[c], value);
+            }
+            else {
+                snapshot.counters[c] += value;
+            }
+        }
+    }
+
+    return snapshot;
+}
+
+// one line per phase with the thread seconds spent in it since previous,
+// then the counters with their rates
+void print_metrics_summary(std::ostream& out, const MetricsSnapshot& now, const MetricsSnapshot& previous, float seconds) {
+    out << "metrics interval_seconds " << seconds << "\n";
+
+    for (int p = 0; p < (int)Phase::COUNT; ++p) {
+        uint64_t calls = now.phase_calls[p] - previous.phase_calls[p];
+
+        if (calls) {
+            double phase_seconds = (now.phase_nanoseconds[p] - previous.phase_nanoseconds[p]) * 1e-9;
+            out << "phase " << PHASE_NAMES[p]
+                << " thread_seconds " << phase_seconds
+                << " calls " << calls
+                << " mean_us " << phase_seconds * 1e6 / calls << "\n";
+        }
+    }
+
+    out << "counters";
+
+    for (int c = 0; c < (int)Counter::COUNT; ++c) {
+        if (c == (int)Counter::tree_nodes_max) {
+            out << " " << COUNTER_NAMES[c] << " " << now.counters[c];
+        }
+        else {
+            out << " " << COUNTER_NAMES[c] << "_per_second " << (now.counters[c] - previous.counters[c]) / seconds;
+        }
+    }
+
+    out << std::endl;
+}
+
+void write_metrics_json(std::ostream& out, const MetricsSnapshot& metrics, float seconds) {
+    out << "{\n  \"seconds\": " << seconds << ",\n  \"phases\": {";
+
+    for (int p = 0; p < (int)Phase::COUNT; ++p) {
+        out << (p ? ",\n" : "\n")
+            << "    \"" << PHASE_NAMES[p] << "\": {\"thread_seconds\": " << metrics.phase_nanoseconds[p] * 1e-9
+            << ", \"calls\": " << metrics.phase_calls[p] << "}";
+    }
+
+    out << "\n  },\n  \"counters\": {";
+
+    for (int c = 0; c < (int)Counter::COUNT; ++c) {
+        out << (c ? ",\n" : "\n") << "    \"" << COUNTER_NAMES[c] << "\": " << metrics.counters[c];
+    }
+
+    out << "\n  }\n}" << std::endl;
+}
+
+// Prints a summary of the last interval every interval while it lives,
+// nothing if the instrumentation is compiled out.
+class MetricsReporter {
+private:
+    std::ostream& out;
+    std::mutex* out_mutex;
+    std::chrono::seconds interval;
+    std::chrono::steady_clock::time_point start;
+
+    std::mutex mutex;
+    std::condition_variable stop_cv;
+    bool stopping = false;
+    std::thread thread;
+
+    void report_loop() {
+        MetricsSnapshot previous = collect_metrics();
+        auto previous_time = std::chrono::steady_clock::now();
+        std::unique_lock <std::mutex> lock(mutex);
+
+        while (not stop_cv.wait_for(lock, interval, [this] { return stopping; })) {
+            MetricsSnapshot now = collect_metrics();
+            auto now_time = std::chrono::steady_clock::now();
+            float seconds = std::chrono::duration<float>(now_time - previous_time).count();
+
+            if (out_mutex) {
+                std::lock_guard <std::mutex> out_lock(*out_mutex);
+                print_metrics_summary(out, now, previous, seconds);
+            }
+            else {
+                print_metrics_summary(out, now, previous, seconds);
+            }
+
+            previous = now;
+            previous_time = now_time;
+        }
+    }
+
+public:
+    // out_mutex, if given, is held while printing
+    MetricsReporter(std::ostream& out, std::chrono::seconds interval, std::mutex* out_mutex = nullptr)
+        : out(out),
+          out_mutex(out_mutex),
+          interval(interval),
+          start(std::chrono::steady_clock::now()) {
+        if (INSTRUMENTATION_COMPILED) {
+            thread = std::thread(&MetricsReporter::report_loop, this);
+        }
+    }
+
+    // totals of the process
+    void write_json(std::ostream& json_out) {
+        if (INSTRUMENTATION_COMPILED) {
+            write_metrics_json(json_out, collect_metrics(), std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    ~MetricsReporter() {
+        {
+            std::lock_guard <std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        stop_cv.notify_one();
+
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+};
+
+#endif
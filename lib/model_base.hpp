@@ -0,0 +1,19 @@
+#ifndef MODEL_BASE
+#define MODEL_BASE
+
+#include <array>
+#include <utility>
+
+// position evaluator used by AlphaZeroAgent; boards use the
+// GameState::write_tensor_representation layout (3 * 64 floats)
+class ModelBase {
+public:
+    virtual std::pair<float, std::array <float, 65>> run_inference(const float* board_tensor) = 0;
+
+    // writes batch_size values and batch_size * 65 policy entries
+    virtual void run_batch_inference(const float* board_tensors, int batch_size, float* values, float* policies) = 0;
+
+    virtual ~ModelBase() = default;
+};
+
+#endif
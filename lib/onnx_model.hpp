@@ -1,16 +1,110 @@
 #ifndef ONNX_MODEL
 #define ONNX_MODEL
 
+#include "model_base.hpp"
+#include "tracing.hpp"
+
 #include <onnxruntime/onnxruntime_cxx_api.h>
-#include <string>
+#include <algorithm>
 #include <array>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 using namespace Ort;
 
-class OnnxModel {
+enum class ExecutionProvider {
+    CPU,
+    CUDA
+};
+
+// session settings of an OnnxModel
+struct ModelConfig {
+    ExecutionProvider provider = ExecutionProvider::CPU;
+    int cuda_device = 0;
+
+    // 0 lets onnxruntime pick, one thread per physical core
+    int intra_op_threads = 0;
+    int inter_op_threads = 1;
+
+    // sessions run on one thread pool of the process instead of starting
+    // their own, so many models do not oversubscribe the cores. The pool is
+    // created with the thread counts of the first model of the process; a
+    // later model that asks for it with other counts, or after the first
+    // model went without it, throws std::invalid_argument. Models with
+    // their own thread counts set this to false.
+    bool global_thread_pool = true;
+
+    // sessions allocate from one CPU arena registered in the environment
+    bool share_allocator = true;
+
+    bool cpu_arena = true;
+    bool memory_pattern = true;
+    GraphOptimizationLevel optimization_level = ORT_ENABLE_ALL;
+
+    // the optimized graph is saved here and loaded instead of the model
+    // while it is newer than the model file; empty optimizes on every load
+    std::string optimized_model_path;
+};
+
+// The onnxruntime environment is one per process, so the global thread pool
+// and the shared allocator are set up by the first model that is created.
+// Later configurations choose whether to use them, but cannot ask for a
+// global pool the environment does not have.
+Env& onnx_env(const ModelConfig& config) {
+    static std::mutex env_mutex;
+    static std::unique_ptr <Env> env;
+    static bool global_pool = false;
+    static int global_intra_op_threads = 0;
+    static int global_inter_op_threads = 0;
+    static bool allocator_registered = false;
+
+    std::lock_guard <std::mutex> lock(env_mutex);
+
+    if (not env) {
+        if (config.global_thread_pool) {
+            ThreadingOptions threading_options;
+            threading_options.SetGlobalIntraOpNumThreads(config.intra_op_threads);
+            threading_options.SetGlobalInterOpNumThreads(config.inter_op_threads);
+            env = std::make_unique<Env>(threading_options, OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "Default");
+            global_pool = true;
+            global_intra_op_threads = config.intra_op_threads;
+            global_inter_op_threads = config.inter_op_threads;
+        }
+        else {
+            env = std::make_unique<Env>(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "Default");
+        }
+    }
+    else if (config.global_thread_pool and not global_pool) {
+        throw std::invalid_argument("the onnxruntime environment was created without a global thread pool");
+    }
+    else if (config.global_thread_pool and (config.intra_op_threads != global_intra_op_threads or config.inter_op_threads != global_inter_op_threads)) {
+        throw std::invalid_argument(
+            "the global thread pool has " + std::to_string(global_intra_op_threads) + " intra-op and "
+            + std::to_string(global_inter_op_threads) + " inter-op threads, requested "
+            + std::to_string(config.intra_op_threads) + " and " + std::to_string(config.inter_op_threads)
+        );
+    }
+
+    if (config.share_allocator and not allocator_registered) {
+        MemoryInfo arena_info = MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemType::OrtMemTypeDefault);
+        ArenaCfg arena_config(0, -1, -1, -1);  // onnxruntime defaults
+        env->CreateAndRegisterAllocator(arena_info, arena_config);
+        allocator_registered = true;
+    }
+
+    return *env;
+}
+
+class OnnxModel : public ModelBase {
 private:
     // ONNX related fields
-    Env env;
+    Env& env;
     SessionOptions sessionOptions;
     MemoryInfo memory_info;
     Session session{nullptr};
@@ -20,65 +114,218 @@ private:
     const size_t INPUT_SIZE = 3 * 64;
     const size_t OUTPUT_SIZE_VALUE = 1;
     const size_t OUTPUT_SIZE_POLICY = 65;
-    const std::vector <int64_t> input_shape = {1, 3, 8, 8};
-    const std::vector <int64_t> output_shape_value = {1, 1};
-    const std::vector <int64_t> output_shape_policy = {1, 65};
 
     std::string model_path;
-    std::array <float, 1> value;
-    std::array <float, 65> policy;
 
-    Value output_tensors[2];
+    // the saved optimized graph can be used while it is not older than the model
+    static bool is_up_to_date(const std::string& optimized_path, const std::string& model_path) {
+        std::error_code error;
+        auto optimized_time = std::filesystem::last_write_time(optimized_path, error);
+
+        if (error) {
+            return false;
+        }
+
+        auto model_time = std::filesystem::last_write_time(model_path, error);
+        return not error and optimized_time >= model_time;
+    }
 
 public:
-    OnnxModel(std::string model_path) 
-        : env(Env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "Default")),
+    // Boards, values and policies of up to capacity positions in buffers that
+    // are bound to the session. Boards are written straight into input() and
+    // the results read in place after run(); the tensors and the binding of a
+    // batch size are created on its first run, so later runs allocate and
+    // copy nothing. One batch is used by one thread at a time, several may run
+    // on the session concurrently. It must not outlive the model.
+    class BoundBatch {
+    private:
+        struct Binding {
+            Value input{nullptr};
+            Value value{nullptr};
+            Value policy{nullptr};
+            IoBinding binding{nullptr};
+        };
+
+        OnnxModel& model;
+        int capacity;
+        std::vector <float> inputs;
+        std::vector <float> values;
+        std::vector <float> policies;
+        std::vector <std::unique_ptr <Binding>> bindings;  // [batch_size - 1]
+
+        Binding& binding(int batch_size) {
+            auto& slot = bindings[batch_size - 1];
+
+            if (not slot) {
+                const std::array <int64_t, 4> input_shape = {batch_size, 3, 8, 8};
+                const std::array <int64_t, 2> value_shape = {batch_size, 1};
+                const std::array <int64_t, 2> policy_shape = {batch_size, 65};
+
+                slot = std::make_unique<Binding>();
+                slot->input = Value::CreateTensor<float>(model.memory_info, inputs.data(), batch_size * model.INPUT_SIZE, input_shape.data(), input_shape.size());
+                slot->value = Value::CreateTensor<float>(model.memory_info, values.data(), batch_size * model.OUTPUT_SIZE_VALUE, value_shape.data(), value_shape.size());
+                slot->policy = Value::CreateTensor<float>(model.memory_info, policies.data(), batch_size * model.OUTPUT_SIZE_POLICY, policy_shape.data(), policy_shape.size());
+
+                slot->binding = IoBinding(model.session);
+                slot->binding.BindInput(model.input_names[0], slot->input);
+                slot->binding.BindOutput(model.output_names[0], slot->value);
+                slot->binding.BindOutput(model.output_names[1], slot->policy);
+            }
+
+            return *slot;
+        }
+
+    public:
+        BoundBatch(OnnxModel& model, int capacity)
+            : model(model),
+              capacity(capacity),
+              inputs(capacity * model.INPUT_SIZE),
+              values(capacity * model.OUTPUT_SIZE_VALUE),
+              policies(capacity * model.OUTPUT_SIZE_POLICY),
+              bindings(capacity) {}
+
+        int get_capacity() const {
+            return capacity;
+        }
+
+        // 3 * 64 floats of the board at position
+        float* input(int position = 0) {
+            return inputs.data() + position * model.INPUT_SIZE;
+        }
+
+        float value(int position = 0) const {
+            return values[position];
+        }
+
+        // 65 move priors of the position
+        const float* policy(int position = 0) const {
+            return policies.data() + position * model.OUTPUT_SIZE_POLICY;
+        }
+
+        // evaluates the first batch_size boards, at most capacity
+        void run(int batch_size) {
+            if (batch_size < 1 or batch_size > capacity) {
+                throw std::out_of_range("batch size " + std::to_string(batch_size) + " out of 1 to " + std::to_string(capacity));
+            }
+
+            TRACE_SCOPE("run_inference", batch_size);
+            model.session.Run(RunOptions{nullptr}, binding(batch_size).binding);
+        }
+
+        BoundBatch(const BoundBatch&) = delete;
+        BoundBatch& operator=(const BoundBatch&) = delete;
+    };
+
+private:
+    // batches of the threads calling run_batch_inference, released with the model
+    std::mutex thread_batches_mutex;
+    std::unordered_map <std::thread::id, std::unique_ptr <BoundBatch>> thread_batches;
+
+    // the batch of the calling thread, grown to hold batch_size positions
+    BoundBatch& thread_batch(int batch_size) {
+        std::lock_guard <std::mutex> lock(thread_batches_mutex);
+        auto& batch = thread_batches[std::this_thread::get_id()];
+
+        if (not batch or batch->get_capacity() < batch_size) {
+            batch = make_bound_batch(std::max(batch_size, batch ? 2 * batch->get_capacity() : 1));
+        }
+
+        return *batch;
+    }
+
+public:
+
+    OnnxModel(std::string model_path, const ModelConfig& config = ModelConfig())
+        : env(onnx_env(config)),
           memory_info(MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemType::OrtMemTypeDefault)),
-          model_path(model_path),
-          output_tensors{Value(nullptr), Value(nullptr)}
+          model_path(model_path)
         {
-        sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
-        OrtCUDAProviderOptions cuda_options;
-        sessionOptions.AppendExecutionProvider_CUDA(cuda_options);
-        
-        session = Session(env, model_path.c_str(), sessionOptions);
-
-        output_tensors[0] = Value::CreateTensor<float>(
-            memory_info, 
-            value.data(), 
-            OUTPUT_SIZE_VALUE,
-            output_shape_value.data(),
-            output_shape_value.size()
-        );
+        if (config.global_thread_pool) {
+            sessionOptions.DisablePerSessionThreads();
+        }
+        else {
+            sessionOptions.SetIntraOpNumThreads(config.intra_op_threads);
+            sessionOptions.SetInterOpNumThreads(config.inter_op_threads);
+        }
 
-        output_tensors[1] = Value::CreateTensor<float>(
-            memory_info, 
-            policy.data(), 
-            OUTPUT_SIZE_POLICY,
-            output_shape_policy.data(),
-            output_shape_policy.size()
-        );
+        if (config.share_allocator) {
+            sessionOptions.AddConfigEntry("session.use_env_allocators", "1");
+        }
+
+        if (config.cpu_arena) {
+            sessionOptions.EnableCpuMemArena();
+        }
+        else {
+            sessionOptions.DisableCpuMemArena();
+        }
+
+        if (config.memory_pattern) {
+            sessionOptions.EnableMemPattern();
+        }
+        else {
+            sessionOptions.DisableMemPattern();
+        }
+
+        if (config.provider == ExecutionProvider::CUDA) {
+            OrtCUDAProviderOptions cuda_options;
+            cuda_options.device_id = config.cuda_device;
+            sessionOptions.AppendExecutionProvider_CUDA(cuda_options);
+        }
+
+        std::string load_path = model_path;
+
+        if (config.optimized_model_path.empty()) {
+            sessionOptions.SetGraphOptimizationLevel(config.optimization_level);
+        }
+        else if (is_up_to_date(config.optimized_model_path, model_path)) {
+            // already optimized
+            load_path = config.optimized_model_path;
+            sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL);
+        }
+        else {
+            sessionOptions.SetGraphOptimizationLevel(config.optimization_level);
+            sessionOptions.SetOptimizedModelFilePath(config.optimized_model_path.c_str());
+        }
+
+        session = Session(env, load_path.c_str(), sessionOptions);
+    }
+
+    std::unique_ptr <BoundBatch> make_bound_batch(int capacity) {
+        return std::make_unique<BoundBatch>(*this, std::max(capacity, 1));
     }
 
     std::pair<float, std::array <float, 65>> run_inference(std::vector <float>& board_tensor) {
+        return run_inference(board_tensor.data());
+    }
 
-        Value input_tensor = Value::CreateTensor<float>(
-            memory_info,
-            board_tensor.data(), 
-            INPUT_SIZE,
-            input_shape.data(),
-            input_shape.size()
-        );
+    // board_tensor has to point to 3 * 64 floats, it is only read; every
+    // thread runs on its own bound batch, so concurrent calls are safe
+    std::pair<float, std::array <float, 65>> run_inference(const float* board_tensor) override {
+        std::pair<float, std::array <float, 65>> result;
+        run_batch_inference(board_tensor, 1, &result.first, result.second.data());
+
+        return result;
+    }
+
+    // board_tensors holds batch_size boards of 3 * 64 floats each; writes
+    // batch_size values and batch_size * 65 policy entries. The boards are
+    // copied into a bound batch of the calling thread, so that no tensors are
+    // created per call
+    void run_batch_inference(const float* board_tensors, int batch_size, float* values, float* policies) override {
+        BoundBatch& batch = thread_batch(batch_size);
+        std::copy(board_tensors, board_tensors + batch_size * INPUT_SIZE, batch.input());
+        batch.run(batch_size);
 
-        session.Run(RunOptions{nullptr}, input_names, &input_tensor, 1, output_names, output_tensors, 2);
+        for (int i = 0; i < batch_size; ++i) {
+            values[i] = batch.value(i);
+        }
 
-        return {value[0], policy};
+        std::copy(batch.policy(), batch.policy() + batch_size * OUTPUT_SIZE_POLICY, policies);
     }
 
     OnnxModel(const OnnxModel&) = delete;
-    OnnxModel(OnnxModel&&) = default;
+    OnnxModel(OnnxModel&&) = delete;
     OnnxModel& operator=(const OnnxModel&) = delete;
-    OnnxModel& operator=(OnnxModel&&) = default;
     ~OnnxModel() = default;
 };
 
@@ -3,175 +3,239 @@
 
 #include "utils.hpp"
 
+#include <cstdint>
 #include <vector>
 #include <string>
 
+struct ZobristKeys {
+    uint64_t stones[2][64];  // [player - 1][square]
+    uint64_t flip[64];       // stones[0][square] ^ stones[1][square]
+    uint64_t black_to_move;
+};
+
+constexpr ZobristKeys make_zobrist_keys() {
+    ZobristKeys keys{};
+    uint64_t seed = 0x2545f4914f6cdd1dULL;
+
+    // splitmix64
+    auto next = [&seed]() {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    };
+
+    for (int player = 0; player < 2; ++player) {
+        for (int id = 0; id < 64; ++id) {
+            keys.stones[player][id] = next();
+        }
+    }
+
+    for (int id = 0; id < 64; ++id) {
+        keys.flip[id] = keys.stones[0][id] ^ keys.stones[1][id];
+    }
+
+    keys.black_to_move = next();
+    return keys;
+}
+
+constexpr ZobristKeys ZOBRIST_KEYS = make_zobrist_keys();
+
 struct GameState {
 private:
-    const std::pair <char, char> MOVE_DIRECTIONS[8] = {
-        {-1, -1},
-        {-1,  0},
-        {-1,  1},
-        { 0, -1},
-        { 0,  1},
-        { 1, -1},
-        { 1,  0},
-        { 1,  1}
+    // search many positions with the bitboard helpers below
+    friend class PlayoutLanes;
+    friend class EndgameSolver;
+
+    // square (x, y) is stored in bit 8 * x + y, same as move_to_id
+    static constexpr int DIRECTION_SHIFTS[8] = {-9, -8, -7, -1, 1, 7, 8, 9};
+
+    // clears the squares that wrapped around the board edge after shifting
+    static constexpr uint64_t DIRECTION_MASKS[8] = {
+        0x7f7f7f7f7f7f7f7fULL,  // {-1, -1}
+        0xffffffffffffffffULL,  // {-1,  0}
+        0xfefefefefefefefeULL,  // {-1,  1}
+        0x7f7f7f7f7f7f7f7fULL,  // { 0, -1}
+        0xfefefefefefefefeULL,  // { 0,  1}
+        0x7f7f7f7f7f7f7f7fULL,  // { 1, -1}
+        0xffffffffffffffffULL,  // { 1,  0}
+        0xfefefefefefefefeULL   // { 1,  1}
     };
 
-    bool can_place(const int x, const int y, const int player) const {
-        if (game_board[x][y]) {
-            return false;
+    static uint64_t shift(const uint64_t bits, const int dir) {
+        const int amount = DIRECTION_SHIFTS[dir];
+        return (amount > 0 ? bits << amount : bits >> -amount) & DIRECTION_MASKS[dir];
+    }
+
+    static uint64_t generate_moves(const uint64_t own, const uint64_t enemy) {
+        const uint64_t empty = ~(own | enemy);
+        uint64_t moves = 0;
+
+        for (int dir = 0; dir < 8; ++dir) {
+            // a line of enemy stones can be at most 6 long
+            uint64_t line = shift(own, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+
+            moves |= shift(line, dir) & empty;
         }
 
-        for (auto dir : MOVE_DIRECTIONS) {
-            bool enemy_exists = false;
-            bool ended_on_my = false;
-            
-            int next_x = x + dir.first;
-            int next_y = y + dir.second;
-
-            while (
-                0 <= next_x and next_x < 8 and
-                0 <= next_y and next_y < 8
-            ) {
-                if (game_board[next_x][next_y] == player) {
-                    ended_on_my = true;
-                    break;
-                }
-                else if (game_board[next_x][next_y] == (player ^ 3)) {
-                    enemy_exists = true;
-                }
-                else {
-                    break;
-                }
+        return moves;
+    }
 
-                next_x += dir.first;
-                next_y += dir.second;
-            }
-        
-            if (enemy_exists and ended_on_my) {
-                return true;
-            }
+    static uint64_t generate_flips(const uint64_t placed, const uint64_t own, const uint64_t enemy) {
+        uint64_t flips = 0;
+
+        for (int dir = 0; dir < 8; ++dir) {
+            uint64_t line = shift(placed, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+            line |= shift(line, dir) & enemy;
+
+            // keep the line only if it is closed by our own stone
+            const uint64_t closed = (shift(line, dir) & own) != 0;
+            flips |= line & (0 - closed);
         }
 
-        return false;
+        return flips;
+    }
+
+    uint64_t& mutable_stones_of(const int player) {
+        return player == 1 ? white_stones : black_stones;
     }
 
     bool needs_recalculate_moves = true;
-    std::vector <move> valid_moves;
+    MoveList valid_moves;
+
+    void recalculate_moves() {
+        valid_moves.clear();
+
+        const uint64_t own = stones_of(current_player);
+        const uint64_t enemy = stones_of(current_player ^ 3);
+        uint64_t moves = generate_moves(own, enemy);
+
+        if (moves == 0) {
+            if (generate_moves(enemy, own) != 0) {
+                valid_moves.push_back({-1, -1});
+            }
+        }
+
+        while (moves) {
+            const int id = __builtin_ctzll(moves);
+            valid_moves.push_back({id / 8, id % 8});
+            moves &= moves - 1;
+        }
+
+        needs_recalculate_moves = false;
+    }
 public:
-    unsigned char game_board[8][8];
+    uint64_t white_stones;
+    uint64_t black_stones;
     int current_player = 2;  // black by default
+    uint64_t hash;  // zobrist hash, updated incrementally by make_move
 
-    GameState() : game_board{} {
+    GameState() {
         // init game board
-        game_board[3][3] = 1;  // white
-        game_board[3][4] = 2;  // black
-        game_board[4][3] = 2;  // black
-        game_board[4][4] = 1;  // white
+        white_stones = (1ULL << (3 * 8 + 3)) | (1ULL << (4 * 8 + 4));
+        black_stones = (1ULL << (3 * 8 + 4)) | (1ULL << (4 * 8 + 3));
 
         current_player = 2;  // set the player to black
         needs_recalculate_moves = true;
-        valid_moves.reserve(64);
+        hash = compute_hash();
     }
 
-    std::vector <move> get_valid_moves() {
-        if (!needs_recalculate_moves) {
-            return valid_moves;
+    uint64_t compute_hash() const {
+        uint64_t result = (current_player == 2 ? ZOBRIST_KEYS.black_to_move : 0);
+
+        for (int player = 1; player <= 2; ++player) {
+            uint64_t stones = stones_of(player);
+
+            while (stones) {
+                result ^= ZOBRIST_KEYS.stones[player - 1][__builtin_ctzll(stones)];
+                stones &= stones - 1;
+            }
         }
 
-        valid_moves.clear();
-        
-        bool terminal = true;
+        return result;
+    }
 
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                if (can_place(i, j, current_player)) {
-                    valid_moves.emplace_back(i, j);
-                    terminal = false;
-                }
+    uint64_t stones_of(const int player) const {
+        return player == 1 ? white_stones : black_stones;
+    }
 
-                if (terminal and can_place(i, j, current_player ^ 3)) {
-                    terminal = false;
-                }
-            }
+    // 0 - empty, 1 - white, 2 - black
+    int get_field(const int x, const int y) const {
+        const uint64_t bit = 1ULL << (8 * x + y);
+
+        if (white_stones & bit) {
+            return 1;
         }
+        if (black_stones & bit) {
+            return 2;
+        }
+        return 0;
+    }
 
-        if (valid_moves.size() == 0 and not terminal) {
-            valid_moves.emplace_back(-1, -1);
+    uint64_t get_valid_moves_mask() const {
+        return generate_moves(stones_of(current_player), stones_of(current_player ^ 3));
+    }
+
+    // cached move list, valid until the next make_move; does not allocate
+    const MoveList& get_move_list() {
+        if (needs_recalculate_moves) {
+            recalculate_moves();
         }
 
-        needs_recalculate_moves = false;
         return valid_moves;
     }
 
+    std::vector <move> get_valid_moves() {
+        const MoveList& moves = get_move_list();
+        return std::vector <move>(moves.begin(), moves.end());
+    }
+
     void make_move(const move& move) {
         // assumes that the move is valid!
         needs_recalculate_moves = true;
 
+        hash ^= ZOBRIST_KEYS.black_to_move;
+
         if (move.first == -1) {
             // skip move
             current_player ^= 3;
             return;
         }
 
-        game_board[move.first][move.second] = current_player;
+        const int placed_id = 8 * move.first + move.second;
+        const uint64_t placed = 1ULL << placed_id;
+        uint64_t& own = mutable_stones_of(current_player);
+        uint64_t& enemy = mutable_stones_of(current_player ^ 3);
+        uint64_t flips = generate_flips(placed, own, enemy);
 
-        for (auto dir : MOVE_DIRECTIONS) {
-            bool ended_on_my = false;
+        own |= placed | flips;
+        enemy &= ~flips;
 
-            std::vector <std::pair <int, int> > enemies;
-    
-            int next_x = move.first + dir.first;
-            int next_y = move.second + dir.second;
+        hash ^= ZOBRIST_KEYS.stones[current_player - 1][placed_id];
 
-            while (
-                0 <= next_x and next_x < 8 and
-                0 <= next_y and next_y < 8
-            ) {
-                if (game_board[next_x][next_y] == current_player) {
-                    ended_on_my = true;
-                    break;
-                }
-                else if (game_board[next_x][next_y] == (current_player ^ 3)) {
-                    enemies.emplace_back(next_x, next_y);
-                }
-                else {
-                    break;
-                }
-
-                next_x += dir.first;
-                next_y += dir.second;
-            }
-        
-            if (ended_on_my) {
-                for (auto& enemy : enemies) {
-                    game_board[enemy.first][enemy.second] ^= 3;
-                }
-            }
+        while (flips) {
+            hash ^= ZOBRIST_KEYS.flip[__builtin_ctzll(flips)];
+            flips &= flips - 1;
         }
 
         current_player ^= 3;  // swap players
     }
 
     std::pair <int, int> get_scores() const {
-        int scores[] = {0, 0};
-
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                if (game_board[i][j]) {
-                    scores[game_board[i][j] - 1]++;
-                }
-            }
-        }
-        
-        return {scores[0], scores[1]};
+        return {__builtin_popcountll(white_stones), __builtin_popcountll(black_stones)};
     }
 
     bool is_terminal() {
-        get_valid_moves();
-        return valid_moves.size() == 0;
+        return get_move_list().empty();
     }
 
     std::string draw() const {
@@ -179,13 +243,15 @@ public:
 
         for (int i = 0; i < 8; ++i) {
             for (int j = 0; j < 8; ++j) {
-                if (game_board[i][j] == 0) {
+                int field = get_field(i, j);
+
+                if (field == 0) {
                     board += "_";
                 }
-                else if (game_board[i][j] == 1) {
+                else if (field == 1) {
                     board += "o";
                 }
-                else if (game_board[i][j] == 2) {
+                else if (field == 2) {
                     board += "@";
                 }
             }
@@ -197,29 +263,27 @@ public:
 
     std::vector <float> get_tensor_representation() const {
         std::vector <float> tensor(3 * 64);
+        write_tensor_representation(tensor.data());
 
+        return tensor;
+    }
+
+    // writes the 3 * 64 floats of the tensor representation into the buffer
+    void write_tensor_representation(float* tensor) const {
         // first player stones
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                tensor[i * 8 + j] = (game_board[i][j] == 1);
-            }
+        for (int id = 0; id < 64; ++id) {
+            tensor[id] = (white_stones >> id) & 1;
         }
 
         // second player stones
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                tensor[64 + i * 8 + j] = (game_board[i][j] == 2);
-            }
+        for (int id = 0; id < 64; ++id) {
+            tensor[64 + id] = (black_stones >> id) & 1;
         }
 
         // current player encoding
-        for (int i = 0; i < 8; ++i) {
-            for (int j = 0; j < 8; ++j) {
-                tensor[128 + i * 8 + j] = (current_player == 2);
-            }
+        for (int id = 0; id < 64; ++id) {
+            tensor[128 + id] = (current_player == 2);
         }
-
-        return tensor;
     }
 };
 
@@ -0,0 +1,147 @@
+#ifndef PLAYOUT
+#define PLAYOUT
+
+#include "othello.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Plays uniformly random moves until the end of the game, returns 1 if
+// player won, -1 if he lost and 0 for a tie.
+int random_playout(GameState& state, int player, std::mt19937& rng) {
+    while (not state.is_terminal()) {
+        const MoveList& valid_moves = state.get_move_list();
+        move mv = valid_moves[rng() % valid_moves.size()];
+
+        state.make_move(mv);
+    }
+
+    auto scores = state.get_scores();
+
+    if (scores.first < scores.second) {
+        return player == 1 ? -1 : 1;
+    }
+
+    if (scores.first > scores.second) {
+        return player == 1 ? 1 : -1;
+    }
+
+    return 0;
+}
+
+// Persistent helper threads that run many playouts from one position. The
+// calling thread takes part in the work, so a pool of n threads starts n - 1
+// helpers.
+class PlayoutPool {
+private:
+    std::vector <std::thread> helpers;
+    std::vector <std::mt19937> rngs;  // one per thread, the caller uses the last
+
+    std::mutex job_mutex;
+    std::condition_variable job_cv;
+    std::condition_variable done_cv;
+    int job_generation = 0;
+    int helpers_busy = 0;
+    bool stopping = false;
+
+    // current job
+    GameState job_state;
+    int job_player = 0;
+    int job_playouts = 0;
+    std::atomic <int> next_playout{0};
+    std::atomic <int> result_sum{0};
+
+    void work(std::mt19937& rng) {
+        int sum = 0;
+
+        while (next_playout.fetch_add(1) < job_playouts) {
+            GameState state = job_state;
+            sum += random_playout(state, job_player, rng);
+        }
+
+        result_sum += sum;
+    }
+
+    void helper_loop(int id) {
+        int seen_generation = 0;
+
+        while (true) {
+            {
+                std::unique_lock <std::mutex> lock(job_mutex);
+                job_cv.wait(lock, [&] { return stopping or job_generation != seen_generation; });
+
+                if (stopping) {
+                    return;
+                }
+
+                seen_generation = job_generation;
+            }
+
+            work(rngs[id]);
+
+            {
+                std::lock_guard <std::mutex> lock(job_mutex);
+                helpers_busy--;
+            }
+
+            done_cv.notify_one();
+        }
+    }
+
+public:
+    PlayoutPool(int threads, uint_fast32_t seed) {
+        std::mt19937 seeder(seed);
+
+        for (int i = 0; i < threads; ++i) {
+            rngs.emplace_back(seeder());
+        }
+
+        for (int i = 0; i + 1 < threads; ++i) {
+            helpers.emplace_back(&PlayoutPool::helper_loop, this, i);
+        }
+    }
+
+    // sum of the results of playouts games from state, see random_playout
+    int run(const GameState& state, int player, int playouts) {
+        {
+            std::lock_guard <std::mutex> lock(job_mutex);
+            job_state = state;
+            job_player = player;
+            job_playouts = playouts;
+            next_playout = 0;
+            result_sum = 0;
+            helpers_busy = helpers.size();
+            job_generation++;
+        }
+
+        job_cv.notify_all();
+        work(rngs.back());
+
+        std::unique_lock <std::mutex> lock(job_mutex);
+        done_cv.wait(lock, [this] { return helpers_busy == 0; });
+
+        return result_sum;
+    }
+
+    ~PlayoutPool() {
+        {
+            std::lock_guard <std::mutex> lock(job_mutex);
+            stopping = true;
+        }
+
+        job_cv.notify_all();
+
+        for (auto& helper : helpers) {
+            helper.join();
+        }
+    }
+
+    PlayoutPool(const PlayoutPool&) = delete;
+    PlayoutPool& operator=(const PlayoutPool&) = delete;
+};
+
+#endif
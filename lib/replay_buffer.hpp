@@ -0,0 +1,57 @@
+#ifndef REPLAY_BUFFER
+#define REPLAY_BUFFER
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// The replay buffer on disk is a directory with one gen_NNNNNN directory of
+// dataset chunks per self-play generation. Training reads a sliding window
+// of the newest generations (alpha_zero/replay_buffer.py).
+
+// generation numbers present under root, oldest first
+std::vector <int> list_generations(const std::string& root) {
+    std::vector <int> generations;
+
+    if (not std::filesystem::exists(root)) {
+        return generations;
+    }
+
+    for (auto& entry : std::filesystem::directory_iterator(root)) {
+        int generation;
+        char tail;
+
+        if (entry.is_directory() and std::sscanf(entry.path().filename().c_str(), "gen_%d%c", &generation, &tail) == 1) {
+            generations.push_back(generation);
+        }
+    }
+
+    std::sort(generations.begin(), generations.end());
+    return generations;
+}
+
+std::string generation_directory(const std::string& root, int generation) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "gen_%06d", generation);
+
+    return (std::filesystem::path(root) / name).string();
+}
+
+// directory for the generation after the newest one
+std::string new_generation_directory(const std::string& root) {
+    std::vector <int> generations = list_generations(root);
+    return generation_directory(root, generations.empty() ? 0 : generations.back() + 1);
+}
+
+// removes all but the newest keep generations
+void prune_generations(const std::string& root, int keep) {
+    std::vector <int> generations = list_generations(root);
+
+    for (int i = 0; i + keep < (int)generations.size(); ++i) {
+        std::filesystem::remove_all(generation_directory(root, generations[i]));
+    }
+}
+
+#endif
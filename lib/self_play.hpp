@@ -0,0 +1,231 @@
+#ifndef SELF_PLAY
+#define SELF_PLAY
+
+#include "agents/alpha_zero_agent.hpp"
+#include "eval_cache.hpp"
+#include "inference_server.hpp"
+#include "instrumentation.hpp"
+#include "othello.hpp"
+#include "simulation_utils.hpp"
+#include "tracing.hpp"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+struct SelfPlayConfig {
+    float puct_factor = 0.3f;
+    int iters_per_move = 800;
+    int batch_size = 8;         // leaves collected per agent before it suspends
+    int concurrent_games = 32;  // games multiplexed on one worker thread
+    int solver_empties = 10;    // positions this close to the end are solved exactly
+    std::shared_ptr <EvalCache> eval_cache;  // shared by all games, may be null
+};
+
+// Ids of the games still to be played, handed out to the worker threads. The
+// seeds of a game's agents follow from the seed base and its id alone, so a
+// resumed run plays the missing games with the seeds of the original run.
+class GameSchedule {
+private:
+    std::mutex mutex;
+    std::vector <int> game_ids;
+    size_t next = 0;
+    uint_fast32_t seed_base;
+
+public:
+    GameSchedule(std::vector <int> game_ids, uint_fast32_t seed_base)
+        : game_ids(std::move(game_ids)),
+          seed_base(seed_base) {}
+
+    bool next_game(int& game_id) {
+        std::lock_guard <std::mutex> lock(mutex);
+
+        if (next == game_ids.size()) {
+            return false;
+        }
+
+        game_id = game_ids[next++];
+        return true;
+    }
+
+    // white and black agent seeds
+    std::pair <uint_fast32_t, uint_fast32_t> game_seeds(int game_id) const {
+        std::seed_seq seq{(uint32_t)seed_base, (uint32_t)game_id};
+        std::mt19937 random_gen(seq);
+        uint_fast32_t white_seed = random_gen();
+
+        return {white_seed, random_gen()};
+    }
+};
+
+// One self-play game driven as a state machine. advance() runs the search
+// until an agent needs its leaves evaluated, submits them to the server and
+// returns; resume() continues once the results are in.
+class SelfPlayGame {
+private:
+    std::unique_ptr <AlphaZeroAgent> agents[2];  // [player - 1]
+    int game_id;
+    GameState state;
+    GameHistory game_history;
+
+    bool searching = false;
+    bool waiting = false;
+    bool finished = false;
+    std::future <void> pending;
+
+    AlphaZeroAgent& current_agent() {
+        return *agents[state.current_player - 1];
+    }
+
+public:
+    SelfPlayGame(ModelBase& model, const SelfPlayConfig& config, int game_id, uint_fast32_t white_seed, uint_fast32_t black_seed)
+        : game_id(game_id) {
+        agents[0] = std::make_unique<AlphaZeroAgent>(model, config.puct_factor, config.iters_per_move, white_seed);
+        agents[1] = std::make_unique<AlphaZeroAgent>(model, config.puct_factor, config.iters_per_move, black_seed);
+        agents[0]->set_batch_size(config.batch_size);
+        agents[1]->set_batch_size(config.batch_size);
+        agents[0]->set_endgame_solver(config.solver_empties);
+        agents[1]->set_endgame_solver(config.solver_empties);
+        agents[0]->set_eval_cache(config.eval_cache);
+        agents[1]->set_eval_cache(config.eval_cache);
+    }
+
+    void advance(InferenceServer& server) {
+        while (not state.is_terminal()) {
+            AlphaZeroAgent& agent = current_agent();
+
+            if (not searching) {
+                agent.begin_search();
+                searching = true;
+            }
+
+            if (not agent.search_done()) {
+                int leaves = agent.prepare_batch();
+
+                if (leaves) {
+                    pending = server.submit(agent.batch_input(), leaves, agent.batch_value_output(), agent.batch_policy_output());
+                    waiting = true;
+                    return;
+                }
+
+                continue;
+            }
+
+            auto [move, policy] = agent.finish_search();
+            searching = false;
+
+            game_history.history.push_back(
+                GameMove{state.get_tensor_representation(), policy, state.current_player, 0}
+            );
+
+            state.make_move(move);
+            agents[0]->make_move(move);
+            agents[1]->make_move(move);
+        }
+
+        set_game_result(game_history, state.get_scores());
+        finished = true;
+    }
+
+    bool is_waiting() const {
+        return waiting;
+    }
+
+    bool is_ready() const {
+        return pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    void wait() const {
+        pending.wait();
+    }
+
+    void resume(InferenceServer& server) {
+        pending.get();
+        waiting = false;
+        current_agent().finish_batch();
+
+        advance(server);
+    }
+
+    bool is_finished() const {
+        return finished;
+    }
+
+    int get_id() const {
+        return game_id;
+    }
+
+    GameHistory& get_history() {
+        return game_history;
+    }
+};
+
+// Plays games from the schedule on the calling thread until it runs out,
+// keeping up to config.concurrent_games of them in flight so that the
+// inference server always has leaves from other games while one game is
+// suspended. Several workers may share the schedule.
+void run_self_play_worker(
+    InferenceServer& server,
+    const SelfPlayConfig& config,
+    GameSchedule& schedule,
+    const std::function<void(int, GameHistory&)>& on_game_finished)
+{
+    InferenceClient model(server);
+    set_trace_thread_name("self-play");
+
+    std::vector <std::unique_ptr <SelfPlayGame>> games;
+    bool scheduled = true;  // the schedule may have more games
+
+    while (scheduled or games.size()) {
+        while (scheduled and (int)games.size() < config.concurrent_games) {
+            int game_id;
+
+            if (not schedule.next_game(game_id)) {
+                scheduled = false;
+                break;
+            }
+
+            auto [white_seed, black_seed] = schedule.game_seeds(game_id);
+            games.push_back(std::make_unique<SelfPlayGame>(model, config, game_id, white_seed, black_seed));
+            games.back()->advance(server);
+        }
+
+        bool progressed = false;
+
+        for (auto& game : games) {
+            if (game->is_waiting() and game->is_ready()) {
+                game->resume(server);
+                progressed = true;
+            }
+        }
+
+        // nothing came back yet, block on the oldest request
+        if (not progressed) {
+            for (auto& game : games) {
+                if (game->is_waiting()) {
+                    PROFILE_SCOPE(inference_wait);
+                    TRACE_SCOPE("wait_inference");
+                    game->wait();
+                    break;
+                }
+            }
+        }
+
+        for (int i = 0; i < (int)games.size(); ++i) {
+            if (games[i]->is_finished()) {
+                PROFILE_COUNT(games, 1);
+                on_game_finished(games[i]->get_id(), games[i]->get_history());
+                games[i] = std::move(games.back());
+                games.pop_back();
+                --i;
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef SIMD_PLAYOUT
+#define SIMD_PLAYOUT
+
+#include "othello.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__) or defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+// Random playouts of many games at once. LANES games advance side by side:
+// move generation, flips and the random generators run for all lanes in one
+// AVX2 register when available, and a finished game hands its lane to the
+// next one. Every lane draws its moves from its own xorshift64 generator.
+// Without AVX2 the same lanes are stepped by scalar code, with the same
+// results for the same seed.
+class PlayoutLanes {
+private:
+    static constexpr int LANES = 4;
+
+    // boards are stored from the view of the player to move
+    alignas(32) uint64_t own[LANES];
+    alignas(32) uint64_t enemy[LANES];
+    alignas(32) uint64_t moves[LANES];
+    alignas(32) uint64_t placed[LANES];
+    alignas(32) uint64_t flips[LANES];
+    alignas(32) uint64_t rng[LANES];
+    bool white_to_move[LANES];
+    bool passed[LANES];
+    bool active[LANES];
+    int game[LANES];  // index of the game played in the lane
+
+    static uint64_t select_bit(uint64_t bits, int k) {
+#ifdef __BMI2__
+        return _pdep_u64(1ULL << k, bits);
+#else
+        while (k--) {
+            bits &= bits - 1;
+        }
+
+        return bits & (0 - bits);
+#endif
+    }
+
+    void generate_moves_scalar() {
+        for (int lane = 0; lane < LANES; ++lane) {
+            moves[lane] = GameState::generate_moves(own[lane], enemy[lane]);
+        }
+    }
+
+    void generate_flips_scalar() {
+        for (int lane = 0; lane < LANES; ++lane) {
+            flips[lane] = GameState::generate_flips(placed[lane], own[lane], enemy[lane]);
+        }
+    }
+
+    void next_random_scalar() {
+        for (int lane = 0; lane < LANES; ++lane) {
+            rng[lane] ^= rng[lane] << 13;
+            rng[lane] ^= rng[lane] >> 7;
+            rng[lane] ^= rng[lane] << 17;
+        }
+    }
+
+#ifdef __AVX2__
+    static __m256i shift_lanes(const __m256i bits, const int dir) {
+        const int amount = GameState::DIRECTION_SHIFTS[dir];
+        const __m256i shifted = amount > 0
+            ? _mm256_sll_epi64(bits, _mm_cvtsi32_si128(amount))
+            : _mm256_srl_epi64(bits, _mm_cvtsi32_si128(-amount));
+
+        return _mm256_and_si256(shifted, _mm256_set1_epi64x(GameState::DIRECTION_MASKS[dir]));
+    }
+
+    void generate_moves_simd() {
+        const __m256i own_v = _mm256_load_si256((const __m256i*)own);
+        const __m256i enemy_v = _mm256_load_si256((const __m256i*)enemy);
+        const __m256i empty = _mm256_xor_si256(_mm256_or_si256(own_v, enemy_v), _mm256_set1_epi64x(-1));
+        __m256i result = _mm256_setzero_si256();
+
+        for (int dir = 0; dir < 8; ++dir) {
+            __m256i line = _mm256_and_si256(shift_lanes(own_v, dir), enemy_v);
+
+            for (int i = 0; i < 5; ++i) {
+                line = _mm256_or_si256(line, _mm256_and_si256(shift_lanes(line, dir), enemy_v));
+            }
+
+            result = _mm256_or_si256(result, _mm256_and_si256(shift_lanes(line, dir), empty));
+        }
+
+        _mm256_store_si256((__m256i*)moves, result);
+    }
+
+    void generate_flips_simd() {
+        const __m256i own_v = _mm256_load_si256((const __m256i*)own);
+        const __m256i enemy_v = _mm256_load_si256((const __m256i*)enemy);
+        const __m256i placed_v = _mm256_load_si256((const __m256i*)placed);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i result = zero;
+
+        for (int dir = 0; dir < 8; ++dir) {
+            __m256i line = _mm256_and_si256(shift_lanes(placed_v, dir), enemy_v);
+
+            for (int i = 0; i < 5; ++i) {
+                line = _mm256_or_si256(line, _mm256_and_si256(shift_lanes(line, dir), enemy_v));
+            }
+
+            // keep the line only in the lanes where our own stone closes it
+            const __m256i open = _mm256_cmpeq_epi64(_mm256_and_si256(shift_lanes(line, dir), own_v), zero);
+            result = _mm256_or_si256(result, _mm256_andnot_si256(open, line));
+        }
+
+        _mm256_store_si256((__m256i*)flips, result);
+    }
+
+    void next_random_simd() {
+        __m256i x = _mm256_load_si256((const __m256i*)rng);
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 7));
+        x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 17));
+        _mm256_store_si256((__m256i*)rng, x);
+    }
+#endif
+
+    void start_game(const int lane, const GameState& state, const int game_id) {
+        own[lane] = state.stones_of(state.current_player);
+        enemy[lane] = state.stones_of(state.current_player ^ 3);
+        white_to_move[lane] = state.current_player == 1;
+        passed[lane] = false;
+        active[lane] = true;
+        game[lane] = game_id;
+    }
+
+    // same convention as random_playout
+    int result(const int lane, const int player) const {
+        const int white = __builtin_popcountll(white_to_move[lane] ? own[lane] : enemy[lane]);
+        const int black = __builtin_popcountll(white_to_move[lane] ? enemy[lane] : own[lane]);
+
+        if (white == black) {
+            return 0;
+        }
+
+        return (white > black) == (player == 1) ? 1 : -1;
+    }
+
+    template <bool use_simd>
+    void run(const GameState& state, const int player, const int count, int* results) {
+        int started = 0;
+        int running = 0;
+
+        for (int lane = 0; lane < LANES; ++lane) {
+            active[lane] = false;
+
+            if (started < count) {
+                start_game(lane, state, started++);
+                running++;
+            }
+        }
+
+        while (running) {
+#ifdef __AVX2__
+            if (use_simd) {
+                generate_moves_simd();
+                next_random_simd();
+            }
+            else
+#endif
+            {
+                generate_moves_scalar();
+                next_random_scalar();
+            }
+
+            for (int lane = 0; lane < LANES; ++lane) {
+                placed[lane] = 0;
+
+                if (not active[lane]) {
+                    continue;
+                }
+
+                if (moves[lane]) {
+                    const uint64_t num_moves = __builtin_popcountll(moves[lane]);
+                    placed[lane] = select_bit(moves[lane], ((rng[lane] >> 32) * num_moves) >> 32);
+                    passed[lane] = false;
+                }
+                else if (not passed[lane]) {
+                    passed[lane] = true;  // pass, the board is only swapped
+                }
+                else {
+                    // neither player can move
+                    results[game[lane]] = result(lane, player);
+                    active[lane] = false;
+                    running--;
+                }
+            }
+
+#ifdef __AVX2__
+            if (use_simd) {
+                generate_flips_simd();
+            }
+            else
+#endif
+            {
+                generate_flips_scalar();
+            }
+
+            for (int lane = 0; lane < LANES; ++lane) {
+                if (active[lane]) {
+                    const uint64_t new_enemy = own[lane] | placed[lane] | flips[lane];
+                    own[lane] = enemy[lane] & ~flips[lane];
+                    enemy[lane] = new_enemy;
+                    white_to_move[lane] = not white_to_move[lane];
+                }
+                else if (started < count) {
+                    start_game(lane, state, started++);
+                    running++;
+                }
+            }
+        }
+    }
+
+public:
+    PlayoutLanes(uint64_t seed = 0) {
+        this->seed(seed);
+    }
+
+    void seed(uint64_t seed) {
+        for (int lane = 0; lane < LANES; ++lane) {
+            // splitmix64, xorshift64 must not start from zero
+            uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            rng[lane] = (z ^ (z >> 31)) | 1;
+        }
+    }
+
+    // plays count random games from state and writes their results for player
+    // into results, see random_playout
+    void play(const GameState& state, int player, int count, int* results) {
+#ifdef __AVX2__
+        run<true>(state, player, count, results);
+#else
+        run<false>(state, player, count, results);
+#endif
+    }
+
+    void play_scalar(const GameState& state, int player, int count, int* results) {
+        run<false>(state, player, count, results);
+    }
+
+    std::vector <int> play(const GameState& state, int player, int count) {
+        std::vector <int> results(count);
+        play(state, player, count, results.data());
+
+        return results;
+    }
+};
+
+#endif
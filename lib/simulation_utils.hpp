@@ -20,6 +20,28 @@ struct GameHistory {
 };
 
 
+// fills in the winner and the value target of every move
+void set_game_result(GameHistory& game_history, std::pair <int, int> scores) {
+    game_history.result = 0;
+
+    if (scores.first < scores.second) {
+        game_history.result = 2;
+    }
+    else if (scores.first > scores.second) {
+        game_history.result = 1;
+    }
+
+    for (auto& mv : game_history.history) {
+        if (game_history.result == 0) {
+            mv.value = 0;
+        }
+        else {
+            mv.value = (mv.player == game_history.result ? 1 : -1);
+        }
+    }
+}
+
+
 GameHistory play_game(
     std::unique_ptr<AgentBase> agent1,
     std::unique_ptr<AgentBase> agent2,
@@ -64,39 +86,20 @@ GameHistory play_game(
         std::cout << scores.first << " " << scores.second << std::endl;
     }
 
-    if (scores.first < scores.second) {
-        if (verbose) {
-            std::cout << "Player 2 wins!" << std::endl;
-        }
+    set_game_result(game_history, scores);
 
-        game_history.result = 2;
-        for (auto& mv : game_history.history) {
-            if (mv.player == 2) {
-                mv.value = 1;
-            } else {
-                mv.value = -1;
-            }
+    if (verbose) {
+        if (game_history.result == 2) {
+            std::cout << "Player 2 wins!" << std::endl;
         }
-    }
-    else if (scores.first > scores.second) {
-        if (verbose) {
+        else if (game_history.result == 1) {
             std::cout << "Player 1 wins!" << std::endl;
         }
-
-        game_history.result = 1;
-        for (auto& mv : game_history.history) {
-            if (mv.player == 1) {
-                mv.value = 1;
-            } else {
-                mv.value = -1;
-            }
+        else {
+            std::cout << "Tie!" << std::endl;
         }
     }
 
-    if (verbose) {
-        std::cout << "Tie!" << std::endl;
-    }
-
     return game_history;
 }
 
@@ -0,0 +1,155 @@
+#ifndef SYMMETRY
+#define SYMMETRY
+
+#include "othello.hpp"
+
+#include <array>
+#include <cstdint>
+
+// The 8 symmetries of the board (dihedral group D4). Symmetry s flips the
+// rows (x -> 7 - x) if s & 1, then mirrors the columns (y -> 7 - y) if s & 2,
+// then transposes the board (x <-> y) if s & 4. Symmetry 0 is the identity.
+const int NUM_SYMMETRIES = 8;
+
+uint64_t flip_rows(uint64_t bits) {
+    return __builtin_bswap64(bits);
+}
+
+uint64_t mirror_columns(uint64_t bits) {
+    // reverses the bits inside every byte
+    bits = ((bits >> 1) & 0x5555555555555555ULL) | ((bits & 0x5555555555555555ULL) << 1);
+    bits = ((bits >> 2) & 0x3333333333333333ULL) | ((bits & 0x3333333333333333ULL) << 2);
+    bits = ((bits >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((bits & 0x0f0f0f0f0f0f0f0fULL) << 4);
+    return bits;
+}
+
+uint64_t transpose(uint64_t bits) {
+    // swaps 4x4, then 2x2, then 1x1 blocks across the main diagonal
+    uint64_t t;
+    t = (bits ^ (bits >> 28)) & 0x00000000f0f0f0f0ULL;
+    bits ^= t ^ (t << 28);
+    t = (bits ^ (bits >> 14)) & 0x0000cccc0000ccccULL;
+    bits ^= t ^ (t << 14);
+    t = (bits ^ (bits >> 7)) & 0x00aa00aa00aa00aaULL;
+    bits ^= t ^ (t << 7);
+    return bits;
+}
+
+uint64_t transform_bitboard(uint64_t bits, int symmetry) {
+    if (symmetry & 1) {
+        bits = flip_rows(bits);
+    }
+
+    if (symmetry & 2) {
+        bits = mirror_columns(bits);
+    }
+
+    if (symmetry & 4) {
+        bits = transpose(bits);
+    }
+
+    return bits;
+}
+
+// transposing turns a row flip into a column mirror and back
+int inverse_symmetry(int symmetry) {
+    if (symmetry & 4) {
+        return 4 | ((symmetry & 1) << 1) | ((symmetry & 2) >> 1);
+    }
+
+    return symmetry;
+}
+
+constexpr std::array <std::array <uint8_t, 65>, NUM_SYMMETRIES> make_square_maps() {
+    std::array <std::array <uint8_t, 65>, NUM_SYMMETRIES> maps{};
+
+    for (int symmetry = 0; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        for (int id = 0; id < 64; ++id) {
+            int x = id / 8, y = id % 8;
+
+            if (symmetry & 1) {
+                x = 7 - x;
+            }
+
+            if (symmetry & 2) {
+                y = 7 - y;
+            }
+
+            if (symmetry & 4) {
+                int tmp = x;
+                x = y;
+                y = tmp;
+            }
+
+            maps[symmetry][id] = 8 * x + y;
+        }
+
+        maps[symmetry][64] = 64;  // pass
+    }
+
+    return maps;
+}
+
+// SQUARE_MAPS[s][id] is the square id (or 64 for pass) moved by symmetry s
+constexpr std::array <std::array <uint8_t, 65>, NUM_SYMMETRIES> SQUARE_MAPS = make_square_maps();
+
+int transform_square(int id, int symmetry) {
+    return SQUARE_MAPS[symmetry][id];
+}
+
+GameState transform_state(const GameState& state, int symmetry) {
+    GameState result;
+    result.white_stones = transform_bitboard(state.white_stones, symmetry);
+    result.black_stones = transform_bitboard(state.black_stones, symmetry);
+    result.current_player = state.current_player;
+    result.hash = result.compute_hash();
+
+    return result;
+}
+
+// transforms the 3 * 64 tensor of GameState::write_tensor_representation
+void transform_tensor(const float* tensor, float* out, int symmetry) {
+    for (int plane = 0; plane < 3; ++plane) {
+        for (int id = 0; id < 64; ++id) {
+            out[plane * 64 + SQUARE_MAPS[symmetry][id]] = tensor[plane * 64 + id];
+        }
+    }
+}
+
+// transforms a policy over the 64 squares and the pass move
+void transform_policy(const float* policy, float* out, int symmetry) {
+    for (int id = 0; id < 65; ++id) {
+        out[SQUARE_MAPS[symmetry][id]] = policy[id];
+    }
+}
+
+// the symmetry that maps the position to its canonical form, the smallest
+// (white, black) pair over all symmetries; equal positions get equal symmetries
+int canonical_symmetry(const GameState& state) {
+    int best = 0;
+    uint64_t best_white = state.white_stones, best_black = state.black_stones;
+
+    for (int symmetry = 1; symmetry < NUM_SYMMETRIES; ++symmetry) {
+        uint64_t white = transform_bitboard(state.white_stones, symmetry);
+        uint64_t black = transform_bitboard(state.black_stones, symmetry);
+
+        if (white < best_white or (white == best_white and black < best_black)) {
+            best = symmetry;
+            best_white = white;
+            best_black = black;
+        }
+    }
+
+    return best;
+}
+
+// hash shared by all symmetric variants of a position
+uint64_t canonical_hash(const GameState& state, int symmetry) {
+    return transform_state(state, symmetry).hash;
+}
+
+uint64_t canonical_hash(const GameState& state) {
+    return canonical_hash(state, canonical_symmetry(state));
+}
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef TRACING
+#define TRACING
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Timeline of search, inference and dataset writes in the Chrome trace
+// event format, viewable in Perfetto or chrome://tracing. Each thread
+// records into its own ring of complete events, the oldest are overwritten
+// once it is full. A finished thread hands its ring to the next new thread,
+// so there are only as many rings as threads running at once and memory
+// stays bounded over a long run, even with the short lived threads of the
+// tree-parallel search. Off until start_tracing; an event costs two clock
+// reads and an uncontended lock.
+
+struct TraceEvent {
+    const char* name;  // string literal
+    int64_t start;     // steady_clock nanoseconds
+    int64_t duration;
+    int64_t count;     // batch size or similar, -1 if none
+};
+
+struct TraceBuffer {
+    std::mutex mutex;
+    std::string thread_name;
+    std::vector <TraceEvent> events;
+    size_t next = 0;
+    bool wrapped = false;
+
+    void clear(size_t capacity) {
+        std::lock_guard <std::mutex> lock(mutex);
+        events.assign(capacity, TraceEvent{});
+        next = 0;
+        wrapped = false;
+    }
+
+    void add(const TraceEvent& event) {
+        std::lock_guard <std::mutex> lock(mutex);
+
+        if (events.empty()) {
+            return;
+        }
+
+        events[next++] = event;
+
+        if (next == events.size()) {
+            next = 0;
+            wrapped = true;
+        }
+    }
+};
+
+// rings are never freed, the events of finished threads stay until overwritten
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector <std::unique_ptr <TraceBuffer>> buffers;
+    std::vector <TraceBuffer*> free_buffers;  // of finished threads
+    size_t events_per_thread = 0;
+    int64_t start = 0;
+};
+
+TraceRegistry& trace_registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+std::atomic <bool>& tracing_enabled() {
+    static std::atomic <bool> enabled{false};
+    return enabled;
+}
+
+int64_t trace_clock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// takes the ring of a finished thread if there is one and returns it when the thread exits
+class TraceBufferOwner {
+private:
+    TraceBuffer* buffer;
+
+public:
+    TraceBufferOwner() {
+        TraceRegistry& registry = trace_registry();
+        std::lock_guard <std::mutex> lock(registry.mutex);
+
+        if (registry.free_buffers.size()) {
+            buffer = registry.free_buffers.back();
+            registry.free_buffers.pop_back();
+
+            // the events stay on the track, they end before the new thread started
+            std::lock_guard <std::mutex> buffer_lock(buffer->mutex);
+            buffer->thread_name.clear();
+        }
+        else {
+            registry.buffers.push_back(std::make_unique<TraceBuffer>());
+            buffer = registry.buffers.back().get();
+            buffer->clear(registry.events_per_thread);
+        }
+    }
+
+    ~TraceBufferOwner() {
+        TraceRegistry& registry = trace_registry();
+        std::lock_guard <std::mutex> lock(registry.mutex);
+        registry.free_buffers.push_back(buffer);
+    }
+
+    TraceBuffer& get() {
+        return *buffer;
+    }
+
+    TraceBufferOwner(const TraceBufferOwner&) = delete;
+    TraceBufferOwner& operator=(const TraceBufferOwner&) = delete;
+};
+
+TraceBuffer& thread_trace_buffer() {
+    thread_local TraceBufferOwner owner;
+    return owner.get();
+}
+
+// drops the events recorded so far and keeps the last events_per_thread of every thread
+void start_tracing(size_t events_per_thread = 1 << 16) {
+    TraceRegistry& registry = trace_registry();
+    std::lock_guard <std::mutex> lock(registry.mutex);
+
+    registry.events_per_thread = events_per_thread;
+    registry.start = trace_clock();
+
+    for (auto& buffer : registry.buffers) {
+        buffer->clear(events_per_thread);
+    }
+
+    tracing_enabled().store(true);
+}
+
+void stop_tracing() {
+    tracing_enabled().store(false);
+}
+
+// shown as the thread's track name, threads may share a name
+void set_trace_thread_name(const std::string& name) {
+    TraceBuffer& buffer = thread_trace_buffer();
+    std::lock_guard <std::mutex> lock(buffer.mutex);
+    buffer.thread_name = name;
+}
+
+class TraceScope {
+private:
+    const char* name;
+    int64_t count;
+    int64_t start;
+
+public:
+    TraceScope(const char* name, int64_t count = -1)
+        : name(name),
+          count(count),
+          start(tracing_enabled().load(std::memory_order_relaxed) ? trace_clock() : -1) {}
+
+    // for counts known only at the end of the scope
+    void set_count(int64_t value) {
+        count = value;
+    }
+
+    ~TraceScope() {
+        if (start >= 0) {
+            thread_trace_buffer().add(TraceEvent{name, start, trace_clock() - start, count});
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+
+// nanoseconds as microseconds with three decimals, never in exponent notation
+void write_trace_microseconds(std::ostream& out, int64_t nanoseconds) {
+    int64_t fraction = nanoseconds % 1000;
+    out << nanoseconds / 1000 << "." << fraction / 100 << fraction / 10 % 10 << fraction % 10;
+}
+
+// Chrome trace JSON of the events still in the rings, timestamps in
+// microseconds since start_tracing; may be called while threads record.
+void write_chrome_trace(std::ostream& out) {
+    TraceRegistry& registry = trace_registry();
+    std::lock_guard <std::mutex> registry_lock(registry.mutex);
+
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"alphazero-othello\"}}";
+
+    std::vector <TraceEvent> events;
+
+    for (size_t tid = 0; tid < registry.buffers.size(); ++tid) {
+        TraceBuffer& buffer = *registry.buffers[tid];
+        std::string thread_name;
+
+        {
+            std::lock_guard <std::mutex> lock(buffer.mutex);
+            thread_name = buffer.thread_name;
+
+            // oldest first
+            events.clear();
+            if (buffer.wrapped) {
+                events.insert(events.end(), buffer.events.begin() + buffer.next, buffer.events.end());
+            }
+            events.insert(events.end(), buffer.events.begin(), buffer.events.begin() + buffer.next);
+        }
+
+        if (not thread_name.empty()) {
+            out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+                << ", \"args\": {\"name\": \"" << thread_name << "\"}}";
+        }
+
+        for (auto& event : events) {
+            // scopes that began before start_tracing
+            if (event.start < registry.start) {
+                continue;
+            }
+
+            out << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid << ", \"ts\": ";
+            write_trace_microseconds(out, event.start - registry.start);
+            out << ", \"dur\": ";
+            write_trace_microseconds(out, event.duration);
+
+            if (event.count >= 0) {
+                out << ", \"args\": {\"count\": " << event.count << "}";
+            }
+
+            out << "}";
+        }
+    }
+
+    out << "\n]}" << std::endl;
+}
+
+#endif
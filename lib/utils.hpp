@@ -1,10 +1,48 @@
 #ifndef UTILS
 #define UTILS
 
+#include <array>
 #include <utility>
 
 using move = std::pair <int, int>;
 
+// fixed-capacity move list, stored inline so that it never allocates
+struct MoveList {
+    // at most 33 legal moves can exist in Othello, plus the pass move
+    static constexpr int MAX_MOVES = 34;
+
+    std::array <move, MAX_MOVES> moves;
+    int count = 0;
+
+    void clear() {
+        count = 0;
+    }
+
+    void push_back(const move& mv) {
+        moves[count++] = mv;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    const move& operator[](const int i) const {
+        return moves[i];
+    }
+
+    const move* begin() const {
+        return moves.data();
+    }
+
+    const move* end() const {
+        return moves.data() + count;
+    }
+};
+
 unsigned int move_to_id(move mv) {
     if (mv.first == -1 and mv.second == -1) {
         return 64;
@@ -13,4 +51,12 @@ unsigned int move_to_id(move mv) {
     return 8 * mv.first + mv.second;
 }
 
+move id_to_move(unsigned int id) {
+    if (id == 64) {
+        return {-1, -1};
+    }
+
+    return {id / 8, id % 8};
+}
+
 #endif
@@ -1,10 +1,28 @@
 # initiate empty model
 python3 alpha_zero/nn_model.py
 
-# infinite loop
+# QUANTIZE=1 plays self-play games with an int8 variant of every trained
+# model, calibrated on the newest games; compare the two with
+# bench-model-comparison before turning it on
+QUANTIZE=${QUANTIZE:-0}
+
+# infinite loop, every iteration adds a generation of games to datasets/
+# and training reads the newest few of them
 while :
 do
-    ./build/collect_dataset
+    # the int8 variant is used while it is not older than the model
+    model=models/trained.onnx
+    if [ "$QUANTIZE" = 1 ] && [ models/trained.int8.onnx -nt models/trained.onnx ]; then
+        model=models/trained.int8.onnx
+    fi
+
+    # continues the newest generation if the last run stopped before all its games were written
+    ./build/collect_dataset --resume --model "$model"
     python3 alpha_zero/train.py
+
+    if [ "$QUANTIZE" = 1 ]; then
+        python3 alpha_zero/quantize.py
+    fi
+
     ./build/play_game
-done
\ No newline at end of file
+done
@@ -0,0 +1,58 @@
+#include "collect_config.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Options given on the command line win over a config file, wherever
+// --config appears among them.
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (not condition) {
+        std::cout << "failed: " << what << std::endl;
+        failures++;
+    }
+}
+
+CollectConfig parse(std::vector <std::string> args) {
+    std::vector <char*> argv = {(char*)"collect_dataset"};
+
+    for (auto& arg : args) {
+        argv.push_back(arg.data());
+    }
+
+    CollectConfig config;
+    config.apply(parse_command_line(argv.size(), argv.data(), {"resume", "help"}));
+
+    return config;
+}
+
+int main() {
+    std::string path = (std::filesystem::temp_directory_path() / "collect_config_test.cfg").string();
+    std::ofstream file(path);
+    file << "games 50  # from the file\n"
+         << "threads 2\n";
+    file.close();
+
+    CollectConfig before = parse({"--games", "10", "--config", path});
+    check(before.games == 10, "--games before --config keeps its value");
+    check(before.threads == 2, "--config before: file value of threads");
+
+    CollectConfig after = parse({"--config", path, "--games", "10"});
+    check(after.games == 10, "--games after --config keeps its value");
+    check(after.threads == 2, "--config after: file value of threads");
+
+    CollectConfig file_only = parse({"--config", path});
+    check(file_only.games == 50, "file value of games");
+    check(file_only.iters_per_move == CollectConfig().iters_per_move, "default for keys missing in the file");
+
+    std::filesystem::remove(path);
+    std::cout << "collect_config failures " << failures << std::endl;
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
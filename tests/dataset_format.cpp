@@ -0,0 +1,98 @@
+#include "dataset_format.hpp"
+#include "othello.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Samples written to a compact chunk come back from read_dataset_chunk with
+// the same board, value and visit shares, also when no move got a visit.
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (not condition) {
+        std::cout << "failed: " << what << std::endl;
+        failures++;
+    }
+}
+
+GameMove sample_of(GameState& state, const std::vector <int>& visits, int value) {
+    GameMove game_move{state.get_tensor_representation(), {}, state.current_player, value};
+    const MoveList& moves = state.get_move_list();
+
+    for (int i = 0; i < moves.size(); ++i) {
+        game_move.policy.emplace_back(moves[i], visits[i % visits.size()]);
+    }
+
+    return game_move;
+}
+
+void compare(const GameMove& game_move, const DatasetSample& sample, const std::string& name) {
+    int sum = 0;
+
+    for (auto& mv : game_move.policy) {
+        sum += mv.second;
+    }
+
+    for (int id = 0; id < 3 * 64; ++id) {
+        check(sample.board[id] == game_move.board[id], name + ": board");
+    }
+
+    std::array <float, 65> expected{};
+
+    for (auto& mv : game_move.policy) {
+        expected[move_to_id(mv.first)] = sum ? mv.second / (float)sum : 1.0f / game_move.policy.size();
+    }
+
+    float total = 0.0f;
+
+    for (int id = 0; id < 65; ++id) {
+        check(std::isfinite(sample.policy[id]), name + ": finite policy");
+        check(std::fabs(sample.policy[id] - expected[id]) < 1e-4f, name + ": policy of square " + std::to_string(id));
+        total += sample.policy[id];
+    }
+
+    check(std::fabs(total - 1.0f) < 1e-3f, name + ": policy sums to 1");
+    check(sample.value == game_move.value, name + ": value");
+}
+
+int main() {
+    GameState state;
+    std::vector <GameMove> game_moves;
+
+    game_moves.push_back(sample_of(state, {3, 0, 5, 1}, 1));
+    state.make_move(state.get_move_list()[0]);
+    game_moves.push_back(sample_of(state, {0}, -1));
+    state.make_move(state.get_move_list()[1]);
+    game_moves.push_back(sample_of(state, {7}, 0));
+
+    CompactChunk chunk;
+    chunk.games = 1;
+
+    for (auto& game_move : game_moves) {
+        chunk.add(game_move);
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "dataset_format_test.bin").string();
+    std::ofstream file(path, std::ios::binary);
+    chunk.write(file);
+    file.close();
+
+    std::vector <DatasetSample> samples = read_dataset_chunk(path);
+    std::filesystem::remove(path);
+
+    check(samples.size() == game_moves.size(), "sample count");
+
+    for (size_t i = 0; i < samples.size() and i < game_moves.size(); ++i) {
+        compare(game_moves[i], samples[i], "sample " + std::to_string(i));
+    }
+
+    std::cout << "dataset_format failures " << failures << std::endl;
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+#include "othello.hpp"
+#include "othello_reference.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Plays random games on the bitboard GameState and the byte board reference
+// side by side and compares everything the rest of the code reads.
+
+int failures = 0;
+
+void check(bool condition, const std::string& what, int game, int ply) {
+    if (not condition) {
+        if (failures < 20) {
+            std::cout << "mismatch game " << game << " ply " << ply << ": " << what << std::endl;
+        }
+
+        failures++;
+    }
+}
+
+void compare(GameState& state, ReferenceGameState& reference, int game, int ply) {
+    for (int x = 0; x < 8; ++x) {
+        for (int y = 0; y < 8; ++y) {
+            check(state.get_field(x, y) == reference.game_board[x][y], "board", game, ply);
+        }
+    }
+
+    check(state.current_player == reference.current_player, "current_player", game, ply);
+    check(state.get_valid_moves() == reference.get_valid_moves(), "valid moves", game, ply);
+    check(state.is_terminal() == reference.is_terminal(), "is_terminal", game, ply);
+    check(state.get_scores() == reference.get_scores(), "get_scores", game, ply);
+    check(state.get_tensor_representation() == reference.get_tensor_representation(), "tensor", game, ply);
+    check(state.hash == state.compute_hash(), "incremental hash", game, ply);
+
+    const MoveList& moves = state.get_move_list();
+    std::vector <move> listed(moves.begin(), moves.end());
+    check(listed == reference.get_valid_moves(), "move list", game, ply);
+}
+
+int main(int argc, char** argv) {
+    int num_games = argc > 1 ? std::stoi(argv[1]) : 5000;
+    std::mt19937 generator(argc > 2 ? std::stoi(argv[2]) : 1234);
+
+    long long positions = 0;
+    int passes = 0;
+
+    for (int game = 0; game < num_games; ++game) {
+        GameState state;
+        ReferenceGameState reference;
+        int ply = 0;
+
+        compare(state, reference, game, ply);
+
+        while (not reference.is_terminal()) {
+            std::vector <move> moves = reference.get_valid_moves();
+            move chosen = moves[generator() % moves.size()];
+
+            if (chosen.first == -1) {
+                passes++;
+            }
+
+            state.make_move(chosen);
+            reference.make_move(chosen);
+            ply++;
+            positions++;
+
+            compare(state, reference, game, ply);
+        }
+    }
+
+    std::cout << "othello_reference games " << num_games
+              << " positions " << positions
+              << " passes " << passes
+              << " failures " << failures << std::endl;
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}